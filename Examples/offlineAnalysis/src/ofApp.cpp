@@ -0,0 +1,67 @@
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+void ofApp::setup(){
+    ofSetFrameRate(60);
+    // two seconds of a known signal, the same samples on every run
+    synth.setup(44100);
+    synth.setDuration(2.0);
+    synth.addSine(440, 0.5);
+    synth.addSine(3000, 0.25);
+    synth.addNoise(0.01);
+
+    // data/test.wav is analyzed instead when there is one
+    bSoundSource *source = &synth;
+    if( ofFile::doesFileExist("test.wav") && file.load("test.wav") ){
+        source = &file;
+    }
+    // nothing starts, run() delivers every block on this thread
+    sound_utils.setup(1024, source, false);
+    sound_utils.setPeakTracking(true, 4, 0); // ignore peaks below 0 dB (noise)
+    analyze();
+}
+
+//--------------------------------------------------------------
+void ofApp::analyze(){
+    uint64_t t = ofGetElapsedTimeMicros();
+    int blocks = sound_utils.run();
+    t = ofGetElapsedTimeMicros()-t;
+
+    result = ofToString(blocks) + " blocks in " + ofToString(t/1000.0, 1) + " ms\n";
+    for( auto &p : sound_utils.getPartials() ){
+        result += "partial " + ofToString(p.id) + ": " + ofToString(p.Hz, 2) + " Hz, " + ofToString(p.db, 1) + " dB, " + ofToString(p.age) + " frames\n";
+    }
+    // the synth is a regression check: both tones must be found
+    if( sound_utils.source == &synth ){
+        bool found_440 = false, found_3000 = false;
+        for( auto &p : sound_utils.getPartials() ){
+            if( fabs(p.Hz-440) < 1 ) found_440 = true;
+            if( fabs(p.Hz-3000) < 1 ) found_3000 = true;
+        }
+        result += found_440 && found_3000 ? "PASS\n" : "FAIL\n";
+    }
+    ofLogNotice("offlineAnalysis") << "\n" << result;
+}
+
+//--------------------------------------------------------------
+void ofApp::update(){
+    sound_utils.update();
+}
+
+//--------------------------------------------------------------
+void ofApp::draw(){
+    ofBackground(0);
+    sound_utils.drawSpectrum(0,ofGetHeight()/2,ofGetWidth(), ofGetHeight()/2);
+    sound_utils.drawSettings(20,20);
+    ofDrawBitmapString(result, 20, 120);
+    ofDrawBitmapString("press r to run again", 20, ofGetHeight()/2-20);
+}
+
+
+void ofApp::keyPressed(int key)
+{
+    // the same result every time: run() rewinds the source
+    if(key =='r'){
+        analyze();
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxbSoundUtils.h"
+
+class ofApp : public ofBaseApp{
+    
+public:
+    void setup();
+    void update();
+    void draw();
+    void keyPressed(int key);
+    void analyze();
+    
+    ofxbSoundUtils sound_utils;
+    bSoundSourceSynth synth;
+    bSoundSourceFile file;
+    string result;
+};
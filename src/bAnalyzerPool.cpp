@@ -0,0 +1,426 @@
+#include "bAnalyzerPool.h"
+
+bAnalyzerPool::Stream::Stream(bAnalyzerPool *_pool, int _frame_size, int _queue_length, int _home, function<void(float *, uint64_t)> _process)
+{
+    pool = _pool;
+    frame_size = _frame_size;
+    queue_length = _queue_length;
+    home = _home;
+    frames.resize((size_t)_frame_size*_queue_length);
+    stamps.resize(_queue_length);
+    process = _process;
+    head = 0;
+    tail = 0;
+    pending = 0;
+    closed = false;
+    frames_dropped = 0;
+    frames_processed = 0;
+}
+
+bool bAnalyzerPool::Stream::push(const float *_frame, bool _wait, uint64_t _stamp)
+{
+    if( closed.load(memory_order_relaxed) ){
+        return false;
+    }
+    unsigned int t = tail.load(memory_order_relaxed);
+    unsigned int h = head.load(memory_order_acquire);
+    while( _wait && t - h >= (unsigned int)queue_length && !closed && pool->running ){
+        this_thread::sleep_for(chrono::microseconds(50));
+        h = head.load(memory_order_acquire);
+    }
+    if( t - h >= (unsigned int)queue_length ){
+        frames_dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    memcpy(&frames[(size_t)(t % queue_length)*frame_size], _frame, frame_size*sizeof(float));
+    stamps[t % queue_length] = _stamp;
+    tail.store(t+1, memory_order_release);
+    if( pending.fetch_add(1) == 0 ){
+        pool->schedule(this, home);
+    }
+    return true;
+}
+
+void bAnalyzerPool::Stream::flush()
+{
+    while( pending.load() > 0 && !closed && pool->running ){
+        this_thread::sleep_for(chrono::microseconds(50));
+    }
+}
+
+int bAnalyzerPool::Stream::getQueueDepth()
+{
+    return (int)(tail.load(memory_order_acquire) - head.load(memory_order_acquire));
+}
+
+int bAnalyzerPool::Stream::getQueueLength()
+{
+    return queue_length;
+}
+
+unsigned long bAnalyzerPool::Stream::getFramesDropped()
+{
+    return frames_dropped.load(memory_order_relaxed);
+}
+
+unsigned long bAnalyzerPool::Stream::getFramesProcessed()
+{
+    return frames_processed.load(memory_order_relaxed);
+}
+
+bAnalyzerPool::bAnalyzerPool()
+{
+    next_worker = 0;
+    running = false;
+    max_streams = 1024;
+    wake_seq = 0;
+    sleepers = 0;
+    next_home = 0;
+}
+
+bAnalyzerPool::~bAnalyzerPool()
+{
+    stop();
+}
+
+void bAnalyzerPool::setup(int _num_threads, int _max_streams)
+{
+    if( running ){
+        return;
+    }
+    if( _num_threads <= 0 ){
+        _num_threads = max(1, (int)thread::hardware_concurrency());
+    }
+    lock_guard<mutex> lock(streams_mutex);
+    max_streams = max(max(1, _max_streams), (int)streams.size());
+    workers.clear();
+    for( int i = 0; i < _num_threads; i++ ){
+        workers.push_back(unique_ptr<Worker>(new Worker()));
+        workers.back()->ready.setup(max_streams);
+        workers.back()->queue.resize(8);
+        workers.back()->queue_first = 0;
+        workers.back()->queue_size = 0;
+    }
+    // streams left with frames by stop() keep their turn
+    for( int i = 0; i < streams.size(); i++ ){
+        if( streams[i]->pending.load() > 0 ){
+            workers[streams[i]->home % workers.size()]->ready.push(streams[i].get());
+        }
+    }
+    running = true;
+    for( int i = 0; i < _num_threads; i++ ){
+        threads.push_back(thread(&bAnalyzerPool::run, this, i));
+    }
+}
+
+void bAnalyzerPool::stop()
+{
+    if( !running ){
+        return;
+    }
+    {
+        lock_guard<mutex> lock(sleep_mutex);
+        running = false;
+    }
+    sleep_cv.notify_all();
+    for( int i = 0; i < threads.size(); i++ ){
+        threads[i].join();
+    }
+    threads.clear();
+    // give back jobs nobody took, their owners count them
+    shared_ptr<Job> job;
+    for( int i = 0; i < workers.size(); i++ ){
+        while( takeJob(i, job) );
+    }
+}
+
+int bAnalyzerPool::getNumThreads()
+{
+    return (int)threads.size();
+}
+
+bAnalyzerPool::Stream *bAnalyzerPool::addStream(int _frame_size, int _queue_length, function<void(float *)> _process)
+{
+    return addStream(_frame_size, _queue_length, [_process](float *_frame, uint64_t){
+        _process(_frame);
+    });
+}
+
+bAnalyzerPool::Stream *bAnalyzerPool::addStream(int _frame_size, int _queue_length, function<void(float *, uint64_t)> _process)
+{
+    if( !running ){
+        setup();
+    }
+    lock_guard<mutex> lock(streams_mutex);
+    if( streams.size() >= max_streams ){
+        ofLogError("bAnalyzerPool") << "addStream: already " << max_streams << " streams, see setup()";
+        return NULL;
+    }
+    // homes spread the streams over the workers, stealing evens out the rest
+    int home = next_home++ % workers.size();
+    streams.push_back(unique_ptr<Stream>(new Stream(this, _frame_size, max(1, _queue_length), home, _process)));
+    return streams.back().get();
+}
+
+void bAnalyzerPool::removeStream(Stream *_stream)
+{
+    if( _stream == NULL ){
+        return;
+    }
+    _stream->closed = true;
+    unique_ptr<Stream> removed;
+    {
+        lock_guard<mutex> lock(streams_mutex);
+        for( int i = 0; i < streams.size(); i++ ){
+            if( streams[i].get() == _stream ){
+                removed = move(streams[i]);
+                streams.erase(streams.begin()+i);
+                break;
+            }
+        }
+    }
+    // workers discard the frames of a closed stream; once none are pending
+    // it is on no ready list and no worker touches it. a stopped pool drops
+    // its lists in the next setup().
+    while( removed && running && removed->pending.load() > 0 ){
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+}
+
+void bAnalyzerPool::parallelFor(int _count, function<void(int)> _fn)
+{
+    parallelFor(make_shared<Job>(_fn), _count);
+}
+
+void bAnalyzerPool::parallelFor(const shared_ptr<Job> &_job, int _count)
+{
+    if( _count <= 0 ){
+        return;
+    }
+    // done first: the store below publishes it with the new run
+    _job->done = 0;
+    _job->state.store((uint64_t)_count << 32);
+    // helpers that start after the work is gone just return
+    int helpers = running ? min(_count-1, (int)workers.size()) : 0;
+    for( int i = _job->queued.load(); i < helpers; i++ ){
+        _job->queued++;
+        enqueue(_job, next_worker.fetch_add(1, memory_order_relaxed) % workers.size());
+    }
+    _job->runAll();
+    // the last call to finish signals, whichever thread ran it
+    unique_lock<mutex> lock(_job->done_mutex);
+    _job->done_cv.wait(lock, [&_job, _count]{ return _job->done.load() >= _count; });
+}
+
+bAnalyzerPool::Job::Job(function<void(int)> _fn)
+{
+    fn = _fn;
+    state = 0;
+    done = 0;
+    queued = 0;
+}
+
+void bAnalyzerPool::Job::runAll()
+{
+    while( true ){
+        uint64_t s = state.fetch_add(1, memory_order_acq_rel);
+        int count = (int)(s >> 32);
+        int i = (int)(s & 0xffffffff);
+        if( i >= count ){
+            return;
+        }
+        fn(i);
+        if( done.fetch_add(1, memory_order_acq_rel)+1 == count ){
+            lock_guard<mutex> lock(done_mutex);
+            done_cv.notify_all();
+        }
+    }
+}
+
+void bAnalyzerPool::wake()
+{
+    // seq_cst pairs with the sleepers++ / predicate check in run(): either
+    // the worker sees the new sequence or we see it sleeping
+    wake_seq.fetch_add(1);
+    if( sleepers.load() > 0 ){
+        // a sleeper is either before its check, which sees the new
+        // sequence, or waiting; never in between while we hold the mutex
+        { lock_guard<mutex> lock(sleep_mutex); }
+        sleep_cv.notify_one();
+    }
+}
+
+void bAnalyzerPool::schedule(Stream *_stream, int _worker)
+{
+    // a stopped pool lists the pending streams again in setup()
+    if( !running ){
+        return;
+    }
+    workers[_worker % workers.size()]->ready.push(_stream);
+    wake();
+}
+
+void bAnalyzerPool::enqueue(const shared_ptr<Job> &_job, int _worker)
+{
+    {
+        Worker &w = *workers[_worker];
+        lock_guard<mutex> lock(w.queue_mutex);
+        if( w.queue_size == w.queue.size() ){
+            // full: unroll into a ring twice the size
+            vector<shared_ptr<Job> > grown(max((size_t)8, 2*w.queue.size()));
+            for( size_t i = 0; i < w.queue_size; i++ ){
+                grown[i] = move(w.queue[(w.queue_first+i) % w.queue.size()]);
+            }
+            w.queue.swap(grown);
+            w.queue_first = 0;
+        }
+        w.queue[(w.queue_first+w.queue_size) % w.queue.size()] = _job;
+        w.queue_size++;
+    }
+    wake();
+}
+
+bool bAnalyzerPool::takeJob(int _worker, shared_ptr<Job> &_job)
+{
+    // own queue first, oldest entry
+    {
+        Worker &w = *workers[_worker];
+        lock_guard<mutex> lock(w.queue_mutex);
+        if( w.queue_size > 0 ){
+            _job = move(w.queue[w.queue_first]);
+            w.queue_first = (w.queue_first+1) % w.queue.size();
+            w.queue_size--;
+            _job->queued--;
+            return true;
+        }
+    }
+    // then steal from the back of the others
+    for( int i = 1; i < workers.size(); i++ ){
+        Worker &w = *workers[(_worker+i) % workers.size()];
+        lock_guard<mutex> lock(w.queue_mutex);
+        if( w.queue_size > 0 ){
+            w.queue_size--;
+            _job = move(w.queue[(w.queue_first+w.queue_size) % w.queue.size()]);
+            _job->queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool bAnalyzerPool::takeStream(int _worker, Stream *&_stream)
+{
+    // own list first, then steal from the others
+    for( int i = 0; i < workers.size(); i++ ){
+        if( workers[(_worker+i) % workers.size()]->ready.pop(_stream) ){
+            return true;
+        }
+    }
+    return false;
+}
+
+void bAnalyzerPool::run(int _worker)
+{
+    while( running ){
+        unsigned int seq = wake_seq.load();
+        shared_ptr<Job> job;
+        if( takeJob(_worker, job) ){
+            job->runAll();
+            continue;
+        }
+        Stream *stream;
+        if( takeStream(_worker, stream) ){
+            processOne(_worker, stream);
+            continue;
+        }
+        unique_lock<mutex> lock(sleep_mutex);
+        sleepers++;
+        sleep_cv.wait(lock, [this, seq]{ return wake_seq.load() != seq || !running; });
+        sleepers--;
+    }
+}
+
+void bAnalyzerPool::processOne(int _worker, Stream *_stream)
+{
+    // pending > 0, so there is a frame
+    unsigned int h = _stream->head.load(memory_order_relaxed);
+    if( !_stream->closed ){
+        int slot = h % _stream->queue_length;
+        _stream->process(&_stream->frames[(size_t)slot*_stream->frame_size], _stream->stamps[slot]);
+        _stream->frames_processed.fetch_add(1, memory_order_relaxed);
+    }
+    _stream->head.store(h+1, memory_order_release);
+    // more frames: back to the end of this worker's list, one frame per turn.
+    // otherwise the stream is let go and not touched again.
+    if( _stream->pending.fetch_sub(1) > 1 ){
+        workers[_worker]->ready.push(_stream);
+    }
+}
+
+void bAnalyzerPool::ReadyList::setup(int _capacity)
+{
+    size_t size = 1;
+    while( size < (size_t)_capacity ){
+        size <<= 1;
+    }
+    cells.reset(new Cell[size]);
+    for( size_t i = 0; i < size; i++ ){
+        cells[i].sequence.store(i, memory_order_relaxed);
+        cells[i].stream = NULL;
+    }
+    mask = size-1;
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+}
+
+bool bAnalyzerPool::ReadyList::push(Stream *_stream)
+{
+    // a cell is free for position pos when its sequence is pos, and holds
+    // the entry for pos once its sequence is pos+1
+    size_t pos = enqueue_pos.load(memory_order_relaxed);
+    Cell *cell;
+    for( ;; ){
+        cell = &cells[pos & mask];
+        intptr_t diff = (intptr_t)cell->sequence.load(memory_order_acquire) - (intptr_t)pos;
+        if( diff == 0 ){
+            if( enqueue_pos.compare_exchange_weak(pos, pos+1, memory_order_relaxed) ){
+                break;
+            }
+        }
+        else if( diff < 0 ){
+            return false;
+        }
+        else{
+            pos = enqueue_pos.load(memory_order_relaxed);
+        }
+    }
+    cell->stream = _stream;
+    cell->sequence.store(pos+1, memory_order_release);
+    return true;
+}
+
+bool bAnalyzerPool::ReadyList::pop(Stream *&_stream)
+{
+    size_t pos = dequeue_pos.load(memory_order_relaxed);
+    Cell *cell;
+    for( ;; ){
+        cell = &cells[pos & mask];
+        intptr_t diff = (intptr_t)cell->sequence.load(memory_order_acquire) - (intptr_t)(pos+1);
+        if( diff == 0 ){
+            if( dequeue_pos.compare_exchange_weak(pos, pos+1, memory_order_relaxed) ){
+                break;
+            }
+        }
+        else if( diff < 0 ){
+            // empty, or the next entry is still being written; its producer
+            // calls wake() once it is there
+            return false;
+        }
+        else{
+            pos = dequeue_pos.load(memory_order_relaxed);
+        }
+    }
+    _stream = cell->stream;
+    cell->sequence.store(pos+mask+1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Shared worker pool for running many analyzers in one process.
+//
+// Each analyzer owns a Stream: a fixed size single-producer/single-consumer
+// frame queue filled from its audio callback. push() never takes a lock:
+// the first frame of an idle stream puts it on its home worker's ready
+// list, a lock free ring. Workers take one frame per turn and put the
+// stream back at the end of their own list, so a busy stream can not
+// starve the rest; idle workers steal ready streams from the others. When
+// a stream's queue is full the new frame is dropped and counted instead
+// of blocking the audio thread. parallelFor jobs go to per-worker queues
+// and are stolen the same way; a Job made once can be run again and again
+// without allocating.
+class bAnalyzerPool{
+public:
+    class Stream{
+    public:
+        // copies _frame (frame_size floats) into the queue. audio thread safe.
+        // returns false and counts a drop when the queue is full, or with
+        // _wait (offline producers only) sleeps until there is room.
+        // _stamp is handed to the process callback with the frame, e.g. the
+        // input position, so it can tell how far apart two frames are.
+        bool push(const float *_frame, bool _wait = false, uint64_t _stamp = 0);
+        // returns once every queued frame has been processed
+        void flush();
+        int getQueueDepth();
+        int getQueueLength();
+        unsigned long getFramesDropped();
+        unsigned long getFramesProcessed();
+
+    private:
+        friend class bAnalyzerPool;
+        Stream(bAnalyzerPool *_pool, int _frame_size, int _queue_length, int _home, function<void(float *, uint64_t)> _process);
+
+        bAnalyzerPool *pool;
+        int frame_size;
+        int queue_length;
+        int home;                       // worker whose list it joins when it becomes ready
+        vector<float> frames;
+        vector<uint64_t> stamps;
+        function<void(float *, uint64_t)> process;
+        atomic<unsigned int> head;      // next frame to process (consumer)
+        atomic<unsigned int> tail;      // next free slot (producer)
+        // frames pushed and not yet taken by a worker. the push that raises
+        // it from 0 puts the stream on a ready list, the worker that lowers
+        // it to 0 lets go of it, so a stream is on at most one list and is
+        // never touched by the pool while it is 0.
+        atomic<unsigned int> pending;
+        atomic<bool> closed;
+        atomic<unsigned long> frames_dropped;
+        atomic<unsigned long> frames_processed;
+    };
+
+    // body of a parallelFor, made once and run any number of times
+    class Job{
+    public:
+        Job(function<void(int)> _fn);
+    private:
+        friend class bAnalyzerPool;
+        void runAll();
+
+        function<void(int)> fn;
+        // count in the high half, next index in the low half: a helper still
+        // queued from an earlier run reads both of the same run and returns
+        atomic<uint64_t> state;
+        atomic<int> done;
+        // entries waiting in the worker queues. they help whichever run is
+        // current when taken, so a run only tops them up to its helpers.
+        atomic<int> queued;
+        mutex done_mutex;
+        condition_variable done_cv;
+    };
+
+    bAnalyzerPool();
+    ~bAnalyzerPool();
+
+    // starts _num_threads workers, 0 means one per hardware thread.
+    // at most _max_streams streams can be added.
+    void setup(int _num_threads = 0, int _max_streams = 1024);
+    // stop feeding the streams before stopping or restarting the pool
+    void stop();
+    int getNumThreads();
+
+    // _process is called on a worker thread with each queued frame, in order.
+    // NULL when _max_streams streams exist already.
+    Stream *addStream(int _frame_size, int _queue_length, function<void(float *)> _process);
+    // the same, with the _stamp each frame was pushed with
+    Stream *addStream(int _frame_size, int _queue_length, function<void(float *, uint64_t)> _process);
+    // stop feeding the stream before removing it. waits for in-flight work.
+    void removeStream(Stream *_stream);
+
+    // calls _fn(0) .. _fn(_count-1) on the workers and the calling thread and
+    // returns when all calls are done. safe to call from a stream callback.
+    // allocates a Job for every call
+    void parallelFor(int _count, function<void(int)> _fn);
+    // the same with a Job made beforehand, no allocation. one run of a Job
+    // at a time; the caller still waits for the calls, so not on an audio
+    // thread.
+    void parallelFor(const shared_ptr<Job> &_job, int _count);
+
+private:
+    // bounded multi-producer/multi-consumer ring of ready streams. every
+    // ring holds max_streams entries, so a push never fails.
+    class ReadyList{
+    public:
+        void setup(int _capacity);
+        bool push(Stream *_stream);
+        bool pop(Stream *&_stream);
+    private:
+        struct Cell{
+            atomic<size_t> sequence;
+            Stream *stream;
+        };
+        unique_ptr<Cell[]> cells;
+        size_t mask;
+        atomic<size_t> enqueue_pos, dequeue_pos;
+    };
+    // jobs of one worker, a ring that only grows: no allocation once it
+    // has seen the most helpers queued at a time
+    struct Worker{
+        ReadyList ready;
+        mutex queue_mutex;
+        vector<shared_ptr<Job> > queue;
+        size_t queue_first, queue_size;
+    };
+
+    // lock free unless a worker sleeps, callable from the audio thread
+    void wake();
+    void schedule(Stream *_stream, int _worker);
+    void enqueue(const shared_ptr<Job> &_job, int _worker);
+    bool takeJob(int _worker, shared_ptr<Job> &_job);
+    bool takeStream(int _worker, Stream *&_stream);
+    void run(int _worker);
+    void processOne(int _worker, Stream *_stream);
+
+    vector<unique_ptr<Worker> > workers;
+    vector<thread> threads;
+    atomic<unsigned int> next_worker;
+    atomic<bool> running;
+    int max_streams;
+    // wake() bumps wake_seq and, only when a worker sleeps, notifies under
+    // sleep_mutex so the notify can not fall between its check and its wait
+    atomic<unsigned int> wake_seq;
+    atomic<int> sleepers;
+    mutex sleep_mutex;
+    condition_variable sleep_cv;
+
+    // ownership only, the workers go through the ready lists
+    mutex streams_mutex;
+    vector<unique_ptr<Stream> > streams;
+    unsigned int next_home;
+};
@@ -31,12 +31,17 @@
 **********************************************************************/
 
 #include "bFFT.h"	
+#include "bFFTKernels.h"
+#include "bFastMath.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <mutex>
+#include <map>
 
 int **bFFT_gFFTBitTable = NULL;
 const int MaxFastBits = 16;
+static std::once_flag bFFT_gFFTBitTableOnce;
 
 int bFFT_IsPowerOfTwo(int x)
 {
@@ -49,13 +54,18 @@ int bFFT_IsPowerOfTwo(int x)
    return true;
 }
 
+/*
+ * Sizes below 2 log an error and return 0; callers check
+ * bFFT_IsPowerOfTwo first.
+ */
+
 int bFFT_NumberOfBitsNeeded(int PowerOfTwo)
 {
    int i;
 
    if (PowerOfTwo < 2) {
-      fprintf(stderr, "Error: FFT called with size %d\n", PowerOfTwo);
-      exit(1);
+      ofLogError("bFFT") << "FFT called with size " << PowerOfTwo;
+      return 0;
    }
 
    for (i = 0;; i++)
@@ -115,12 +125,16 @@ void bFFT_FFT(int NumSamples,
    float tr, ti;                /* temp real, temp imaginary */
 
    if (!bFFT_IsPowerOfTwo(NumSamples)) {
-      fprintf(stderr, "%d is not a power of two\n", NumSamples);
-      exit(1);
+      /* no transform: the outputs are zeroed rather than left unwritten */
+      ofLogError("bFFT") << NumSamples << " is not a power of two";
+      for (i = 0; i < NumSamples; i++) {
+         RealOut[i] = 0.0;
+         ImagOut[i] = 0.0;
+      }
+      return;
    }
 
-   if (!bFFT_gFFTBitTable)
-      bFFT_InitFFT();
+   std::call_once(bFFT_gFFTBitTableOnce, bFFT_InitFFT);
 
    if (InverseTransform)
       angle_numerator = -angle_numerator;
@@ -266,6 +280,170 @@ void bFFT_RealFFT(int NumSamples, float *RealIn, float *RealOut, float *ImagOut)
    delete[]tmpImag;
 }
 
+/*
+ * Plans
+ *
+ * A plan holds everything RealFFT recomputes on each call: the bit
+ * reversal permutation, the per-stage twiddles and the split twiddles
+ * of the real transform, plus the analysis window.  Plans are immutable
+ * once built and cached by size, so they can be shared between threads.
+ */
+
+/*
+ * Fixed size kernel for a complex length, NULL when there is none.
+ */
+
+typedef void (*bFFT_Kernel)(const float *, const float *, float *, float *);
+
+bFFT_Kernel bFFT_GetKernel(int NumSamples)
+{
+   switch (NumSamples) {
+   case 128:  return &bFFTKernel<128>::run;
+   case 256:  return &bFFTKernel<256>::run;
+   case 512:  return &bFFTKernel<512>::run;
+   case 1024: return &bFFTKernel<1024>::run;
+   case 2048: return &bFFTKernel<2048>::run;
+   default:   return NULL;
+   }
+}
+
+shared_ptr<const bFFTPlan> bFFT_GetPlan(int _size)
+{
+   static std::mutex plans_mutex;
+   static std::map<int, weak_ptr<const bFFTPlan> > plans;
+
+   if (!bFFT_IsPowerOfTwo(_size) || _size < 4) {
+      ofLogError("bFFT") << _size << " is not a power of two (>= 4)";
+      return nullptr;
+   }
+
+   std::lock_guard<std::mutex> lock(plans_mutex);
+   shared_ptr<const bFFTPlan> cached = plans[_size].lock();
+   if (cached)
+      return cached;
+
+   shared_ptr<bFFTPlan> plan = make_shared<bFFTPlan>();
+   plan->size = _size;
+   plan->half = _size / 2;
+   plan->bits = bFFT_NumberOfBitsNeeded(plan->half);
+
+   plan->bitrev.resize(plan->half);
+   for (int i = 0; i < plan->half; i++)
+      plan->bitrev[i] = bFFT_ReverseBits(i, plan->bits);
+
+   plan->twiddle_real.resize(plan->half / 2);
+   plan->twiddle_imag.resize(plan->half / 2);
+   plan->post_real.resize(plan->half / 2);
+   plan->post_imag.resize(plan->half / 2);
+   for (int k = 0; k < plan->half / 2; k++) {
+      plan->twiddle_real[k] = cos(2.0 * M_PI * k / plan->half);
+      plan->twiddle_imag[k] = sin(2.0 * M_PI * k / plan->half);
+      plan->post_real[k] = cos(M_PI * k / plan->half);
+      plan->post_imag[k] = sin(M_PI * k / plan->half);
+   }
+
+   plan->kernel = bFFT_GetKernel(plan->half);
+
+   plan->window.resize(_size);
+   for (int i = 0; i < _size; i++)
+      plan->window[i] = 0.50 - 0.50 * cos(2 * M_PI * i / (_size - 1));
+
+   plans[_size] = plan;
+   return plan;
+}
+
+/*
+ * Complex FFT of plan->half points using the plan's tables.
+ * Same sign convention and output as bFFT_FFT(..., false, ...).
+ */
+
+void bFFT_PlannedFFT(const bFFTPlan &plan,
+         const float *RealIn, const float *ImagIn, float *RealOut, float *ImagOut)
+{
+   int NumSamples = plan.half;
+   int i, j, k, n;
+   int BlockSize, BlockEnd;
+   float tr, ti;
+
+   if (plan.kernel) {
+      plan.kernel(RealIn, ImagIn, RealOut, ImagOut);
+      return;
+   }
+
+   for (i = 0; i < NumSamples; i++) {
+      j = plan.bitrev[i];
+      RealOut[j] = RealIn[i];
+      ImagOut[j] = ImagIn[i];
+   }
+
+   const float *twr = plan.twiddle_real.data();
+   const float *twi = plan.twiddle_imag.data();
+
+   BlockEnd = 1;
+   for (BlockSize = 2; BlockSize <= NumSamples; BlockSize <<= 1) {
+      int stride = NumSamples / BlockSize;
+
+      for (i = 0; i < NumSamples; i += BlockSize) {
+         for (j = i, n = 0; n < BlockEnd; j++, n++) {
+            float ar = twr[n * stride];
+            float ai = twi[n * stride];
+
+            k = j + BlockEnd;
+            tr = ar * RealOut[k] - ai * ImagOut[k];
+            ti = ar * ImagOut[k] + ai * RealOut[k];
+
+            RealOut[k] = RealOut[j] - tr;
+            ImagOut[k] = ImagOut[j] - ti;
+
+            RealOut[j] += tr;
+            ImagOut[j] += ti;
+         }
+      }
+
+      BlockEnd = BlockSize;
+   }
+}
+
+/*
+ * Real FFT of plan->size points, same output layout as bFFT_RealFFT.
+ * tmpReal and tmpImag are caller supplied scratch of plan->half floats.
+ */
+
+void bFFT_PlannedRealFFT(const bFFTPlan &plan, const float *RealIn,
+         float *RealOut, float *ImagOut, float *tmpReal, float *tmpImag)
+{
+   int Half = plan.half;
+   int i, i3;
+   float h1r, h1i, h2r, h2i;
+
+   for (i = 0; i < Half; i++) {
+      tmpReal[i] = RealIn[2 * i];
+      tmpImag[i] = RealIn[2 * i + 1];
+   }
+
+   bFFT_PlannedFFT(plan, tmpReal, tmpImag, RealOut, ImagOut);
+
+   for (i = 1; i < Half / 2; i++) {
+      float wr = plan.post_real[i];
+      float wi = plan.post_imag[i];
+
+      i3 = Half - i;
+
+      h1r = 0.5 * (RealOut[i] + RealOut[i3]);
+      h1i = 0.5 * (ImagOut[i] - ImagOut[i3]);
+      h2r = 0.5 * (ImagOut[i] + ImagOut[i3]);
+      h2i = -0.5 * (RealOut[i] - RealOut[i3]);
+
+      RealOut[i] = h1r + wr * h2r - wi * h2i;
+      ImagOut[i] = h1i + wr * h2i + wi * h2r;
+      RealOut[i3] = h1r - wr * h2r + wi * h2i;
+      ImagOut[i3] = -h1i + wr * h2i + wi * h2r;
+   }
+
+   RealOut[0] = (h1r = RealOut[0]) + ImagOut[0];
+   ImagOut[0] = h1r - ImagOut[0];
+}
+
 /*
  * PowerSpectrum
  *
@@ -398,25 +576,57 @@ void bFFT_WindowFunc(int whichFunction, int NumSamples, float *in)
 
 /* constructor */
 bFFT::bFFT() {
+    magnitude = NULL;
+    phase = NULL;
+    power = NULL;
+    sound = NULL;
+    bufsize = 0;
+    output_mask = BFFT_OUTPUT_ALL;
+    math_mode = BFFT_MATH_EXACT;
 }
 
 /* destructor */
 bFFT::~bFFT() {
-    delete magnitude;
-    delete phase;
-    delete power;
+    delete[] magnitude;
+    delete[] phase;
+    delete[] power;
+    delete[] sound;
 }
 
 void bFFT::setup(int _bufsize, int _sampling_rate)
 {
     bufsize = _bufsize;
     sampling_rate = _sampling_rate;
+    plan = bFFT_GetPlan(bufsize);
     magnitude = new float[bufsize];
     phase = new float[bufsize];
     power = new float[bufsize];
     spectrum.resize(bufsize/2);
     sound = new float[bufsize];
 
+    in_real.resize(bufsize);
+    out_real.resize(bufsize);
+    out_img.resize(bufsize);
+    tmp_real.resize(bufsize/2);
+    tmp_img.resize(bufsize/2);
+    db.resize(bufsize/2);
+    
+    float freq_step = getFreqStep(sampling_rate, bufsize);
+    for( int i = 0; i < spectrum.size(); i++ ){
+        spectrum[i].power = 0;
+        spectrum[i].db = 0;
+        spectrum[i].Hz = freq_step*i;
+    }
+}
+
+void bFFT::setOutputMask(int _mask)
+{
+    output_mask = _mask;
+}
+
+void bFFT::setMathMode(int _mode)
+{
+    math_mode = _mode;
 }
 
 void bFFT::update(float *_input_sound)
@@ -429,48 +639,65 @@ void bFFT::update(float *_input_sound)
                    &phase[0],
                    &power[0],
                    &avg_power);
-    memcpy(sound, _input_sound, bufsize);
+    memcpy(sound, _input_sound, bufsize*sizeof(float));
 }
 /* Calculate the power spectrum */
 void bFFT::powerSpectrum(int start, int half, float *data, int windowSize,float *magnitude,float *phase, float *power, float *avg_power) {
     int i;
-    int windowFunc = 3;
     float total_power = 0.0f;
     
-    /* processing variables*/
-    float *in_real = new float[windowSize];
-    float *in_img = new float[windowSize];
-    float *out_real = new float[windowSize];
-    float *out_img = new float[windowSize];
+    if( !plan || plan->size != windowSize ){
+        // nothing to transform with: report silence instead of stale or
+        // uninitialised values
+        ofLogError("bFFT") << "powerSpectrum: window size " << windowSize << " does not match setup";
+        for (i = 0; i < half; i++) {
+            magnitude[i] = phase[i] = power[i] = 0;
+        }
+        for (i = 0; i < min(half, (int)spectrum.size()); i++) {
+            spectrum[i].power = 0;
+            spectrum[i].db = 0;
+        }
+        max_power = 0;
+        *(avg_power) = 0;
+        return;
+    }
     
+    /* Hanning window from the shared plan */
+    const float *window = plan->window.data();
     for (i = 0; i < windowSize; i++) {
-        in_real[i] = data[start + i];
+        in_real[i] = data[start + i] * window[i];
     }
     
-    bFFT_WindowFunc(windowFunc, windowSize, in_real);
-    bFFT_RealFFT(windowSize, in_real, out_real, out_img);
+    bFFT_PlannedRealFFT(*plan, &in_real[0], &out_real[0], &out_img[0], &tmp_real[0], &tmp_img[0]);
     
     max_power = 0.0;
     for (i = 0; i < half; i++) {
         /* compute power */
         power[i] = out_real[i]*out_real[i] + out_img[i]*out_img[i];
         total_power += power[i];
-        /* compute magnitude and phase */
-        magnitude[i] = 2.0*sqrt(power[i]);
-        phase[i] = atan2(out_img[i],out_real[i]);
-        
         if( max_power < power[i] )max_power = power[i];
+    }
+    
+    /* everything else only when asked for */
+    bool fast = math_mode == BFFT_MATH_FAST;
+    if( output_mask & BFFT_OUTPUT_MAGNITUDE ){
+        if( fast ) bFastMath_Sqrt(power, magnitude, half, 2.0f);
+        else for (i = 0; i < half; i++) magnitude[i] = 2.0*sqrt(power[i]);
+    }
+    if( output_mask & BFFT_OUTPUT_PHASE ){
+        if( fast ) bFastMath_Atan2(&out_img[0], &out_real[0], phase, half);
+        else for (i = 0; i < half; i++) phase[i] = atan2(out_img[i],out_real[i]);
+    }
+    if( output_mask & BFFT_OUTPUT_DB ){
+        if( fast ) bFastMath_Log10(power, &db[0], half, 10.0f);
+        else for (i = 0; i < half; i++) db[i] = 10*log10(power[i]);
+        for (i = 0; i < half; i++) spectrum[i].db = db[i];
+    }
+    for (i = 0; i < half; i++) {
         spectrum[i].power = power[i];
-        spectrum[i].db    = 10*log10(power[i]);
-        spectrum[i].Hz = getFreqStep(sampling_rate, bufsize)*i;
     }
     /* calculate average power */
     *(avg_power) = total_power / (float) half;
-    
-    delete[]in_real;
-    delete[]in_img;
-    delete[]out_real;
-    delete[]out_img;
 }
 
 void bFFT::inversePowerSpectrum(int start, int half, int windowSize, float *finalOut,float *magnitude,float *phase) {
@@ -522,15 +749,46 @@ float bFFT::getFreqStep()
     return sampling_rate/(float)bufsize;
 }
 
+float bFFT::getPsdScale()
+{
+    if( !plan ){
+        ofLogError("bFFT") << "getPsdScale: no plan for size " << bufsize;
+        return 0;
+    }
+    double sum = 0;
+    for( int i = 0; i < plan->size; i++ ){
+        sum += plan->window[i]*plan->window[i];
+    }
+    return 2.0/(sampling_rate*sum);
+}
+
+int bFFT::getBin(float _hz)
+{
+    // bins are evenly spaced, no search needed
+    if( !(_hz >= 0) || spectrum.empty() ){
+        return -1;
+    }
+    int i = (int)(_hz/getFreqStep());
+    if( i >= spectrum.size() ){
+        return -1;
+    }
+    // the division can round across a bin edge, keep Hz <= _hz < next Hz
+    if( i > 0 && spectrum[i].Hz > _hz ){
+        i--;
+    }
+    else if( i+1 < spectrum.size() && spectrum[i+1].Hz <= _hz ){
+        i++;
+    }
+    return i;
+}
+
 float bFFT::getPower(float _hz)
 {
-    for( int i = 0 ; i < spectrum.size()-1; i++){
-        if( spectrum[i].Hz <= _hz &&
-           _hz < spectrum[i+1].Hz){
-            return (spectrum[i].power+spectrum[i+1].power)/2.0;
-        }
+    int i = getBin(_hz);
+    if( i < 0 || i+1 >= spectrum.size() ){
+        return -1;
     }
-    return -1;
+    return (spectrum[i].power+spectrum[i+1].power)/2.0;
 }
 
 double bFFT::getDFTPower(float _hz)
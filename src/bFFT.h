@@ -8,12 +8,49 @@
 #endif
 
 
+// what bFFT::update computes besides power (always computed)
+#define BFFT_OUTPUT_POWER 1
+#define BFFT_OUTPUT_MAGNITUDE 2
+#define BFFT_OUTPUT_PHASE 4
+#define BFFT_OUTPUT_DB 8
+#define BFFT_OUTPUT_ALL 15
+
+// libm, or the vectorized approximations in bFastMath.h (error bounds there)
+#define BFFT_MATH_EXACT 0
+#define BFFT_MATH_FAST 1
+
 struct Spectrum{
     float power;
     float db;
     float Hz;
 };
 
+// Immutable per-size tables (bit reversal, twiddles, Hanning window).
+// Plans are shared between every bFFT of the same size, so many analyzers
+// running in one process do not each build their own copy.
+struct bFFTPlan{
+    int size;                   // real input length
+    int half;                   // complex FFT length (size/2)
+    int bits;                   // log2(half)
+    vector<int> bitrev;         // bit reversed index for half
+    vector<float> twiddle_real; // cos(2*pi*k/half), k < half/2
+    vector<float> twiddle_imag; // sin(2*pi*k/half)
+    vector<float> post_real;    // cos(pi*k/half), k < half/2, real FFT split
+    vector<float> post_imag;    // sin(pi*k/half)
+    vector<float> window;       // Hanning window, length size
+    // fixed size kernel for half (see bFFTKernels.h), NULL uses the generic loop
+    void (*kernel)(const float *RealIn, const float *ImagIn, float *RealOut, float *ImagOut);
+};
+
+// returns the shared plan for _size, building it on first use (thread safe).
+shared_ptr<const bFFTPlan> bFFT_GetPlan(int _size);
+// complex FFT of plan.half points
+void bFFT_PlannedFFT(const bFFTPlan &plan,
+         const float *RealIn, const float *ImagIn, float *RealOut, float *ImagOut);
+// real FFT of plan.size points, tmpReal/tmpImag are scratch of plan.half floats
+void bFFT_PlannedRealFFT(const bFFTPlan &plan, const float *RealIn,
+         float *RealOut, float *ImagOut, float *tmpReal, float *tmpImag);
+
 class bFFT {
 	
 	public:
@@ -22,8 +59,14 @@ class bFFT {
 	~bFFT();
     void setup(int _bufsize, int _sampling_rate);
     void update( float *_input_sound );
+    // BFFT_OUTPUT_* flags, default BFFT_OUTPUT_ALL. outputs left out keep
+    // their previous values (magnitude, phase, spectrum[i].db).
+    void setOutputMask(int _mask);
+    // BFFT_MATH_EXACT (default) or BFFT_MATH_FAST
+    void setMathMode(int _mode);
     
-    /* Calculate the power spectrum */
+    /* Calculate the power spectrum; all outputs are zeroed when
+       windowSize does not match setup() */
     void powerSpectrum(int start, int half, float *data, int windowSize,float *magnitude,float *phase, float *power, float *avg_power);
     /* ... the inverse */
     void inversePowerSpectrum(int start, int half, int windowSize, float *finalOut,float *magnitude,float *phase);
@@ -34,9 +77,15 @@ class bFFT {
     // get step size of frequency
     float getFreqStep(int sampling_rate, int buffer_size);
     float getFreqStep();
+    // bin containing _hz (the one at or below it), -1 outside the spectrum
+    int getBin(float _hz);
     float getPower(float _hz);
+    // power * getPsdScale() is the one-sided power spectral density (units^2/Hz),
+    // 0 when setup() got a size without a plan
+    float getPsdScale();
     double getDFTPower(float _hz);
   
+    shared_ptr<const bFFTPlan> plan;
     int bufsize,sampling_rate;
     float *magnitude;  // 振幅
     float *phase;      //
@@ -45,6 +94,12 @@ class bFFT {
     float *sound;
     float max_power;
     vector<Spectrum>spectrum;
+    int output_mask;
+    int math_mode;
+
+private:
+    // scratch buffers, allocated once in setup so update() does not hit the heap
+    vector<float> in_real, out_real, out_img, tmp_real, tmp_img, db;
 };
 
 
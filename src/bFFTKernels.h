@@ -0,0 +1,128 @@
+#pragma once
+
+// Fixed size complex FFT kernels.
+//
+// For the complex lengths behind the common buffer sizes (bufsize 256 to
+// 4096, i.e. 128 to 2048 complex points) the bit reversal permutation and
+// the twiddles of every stage are computed at compile time, the first two
+// stages are fused into one unrolled radix-4 pass, and each later stage is
+// its own instantiation with a constant block size and a contiguous
+// twiddle run, so the inner loop has fixed trip counts and unit stride.
+// Results match bFFT_PlannedFFT (same sign convention, no normalization).
+//
+// Only bFFT.cpp includes this; bFFT::setup picks a kernel through the plan.
+
+#ifndef M_PI
+#define	M_PI		3.14159265358979323846  /* pi */
+#endif
+
+// sin() usable in constant expressions. range reduced Taylor series,
+// accurate to double precision on [-pi/2, pi/2].
+constexpr double bFFT_ConstSin(double x)
+{
+    while( x > M_PI ) x -= 2*M_PI;
+    while( x < -M_PI ) x += 2*M_PI;
+    if( x > M_PI/2 ) x = M_PI - x;
+    if( x < -M_PI/2 ) x = -M_PI - x;
+    double term = x, sum = x;
+    for( int i = 1; i < 14; i++ ){
+        term *= -x*x/((2*i)*(2*i+1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double bFFT_ConstCos(double x)
+{
+    return bFFT_ConstSin(x + M_PI/2);
+}
+
+// bit reversed index of every i < N
+template<int N>
+struct bFFTBitReverse{
+    int index[N];
+    constexpr bFFTBitReverse() : index(){
+        int bits = 0;
+        while( (1 << bits) < N ) bits++;
+        for( int i = 0; i < N; i++ ){
+            int rev = 0;
+            for( int b = 0, v = i; b < bits; b++, v >>= 1 ){
+                rev = (rev << 1) | (v & 1);
+            }
+            index[i] = rev;
+        }
+    }
+};
+
+// twiddles of all stages, stage of block size B starts at B/2-1 and holds
+// exp(+2*pi*i*n/B) for n < B/2.
+template<int N>
+struct bFFTStageTwiddles{
+    float real[N];
+    float imag[N];
+    constexpr bFFTStageTwiddles() : real(), imag(){
+        for( int B = 2; B <= N; B <<= 1 ){
+            for( int n = 0; n < B/2; n++ ){
+                real[B/2-1+n] = (float)bFFT_ConstCos(2*M_PI*n/B);
+                imag[B/2-1+n] = (float)bFFT_ConstSin(2*M_PI*n/B);
+            }
+        }
+    }
+};
+
+template<int N> constexpr bFFTBitReverse<N> bFFT_kBitReverse = bFFTBitReverse<N>();
+template<int N> constexpr bFFTStageTwiddles<N> bFFT_kTwiddles = bFFTStageTwiddles<N>();
+
+// one radix-2 stage of block size B, then the next one
+template<int N, int B, bool Done = (B > N)>
+struct bFFTStage{
+    static inline void run(float *re, float *im){
+        const int half = B/2;
+        const float *twr = &bFFT_kTwiddles<N>.real[half-1];
+        const float *twi = &bFFT_kTwiddles<N>.imag[half-1];
+        for( int i = 0; i < N; i += B ){
+            float *r0 = re + i, *i0 = im + i;
+            float *r1 = r0 + half, *i1 = i0 + half;
+            for( int n = 0; n < half; n++ ){
+                float tr = twr[n]*r1[n] - twi[n]*i1[n];
+                float ti = twr[n]*i1[n] + twi[n]*r1[n];
+                r1[n] = r0[n] - tr;
+                i1[n] = i0[n] - ti;
+                r0[n] += tr;
+                i0[n] += ti;
+            }
+        }
+        bFFTStage<N, B*2>::run(re, im);
+    }
+};
+
+template<int N, int B>
+struct bFFTStage<N, B, true>{
+    static inline void run(float *, float *){}
+};
+
+template<int N>
+struct bFFTKernel{
+    static void run(const float *RealIn, const float *ImagIn, float *RealOut, float *ImagOut){
+        const int *rev = bFFT_kBitReverse<N>.index;
+        for( int i = 0; i < N; i++ ){
+            RealOut[rev[i]] = RealIn[i];
+            ImagOut[rev[i]] = ImagIn[i];
+        }
+
+        // block sizes 2 and 4 fused: twiddles are 1 and +i, no multiplies
+        for( int j = 0; j < N; j += 4 ){
+            float *r = RealOut + j, *m = ImagOut + j;
+            float a0r = r[0] + r[1], a0i = m[0] + m[1];
+            float a1r = r[0] - r[1], a1i = m[0] - m[1];
+            float a2r = r[2] + r[3], a2i = m[2] + m[3];
+            float a3r = r[2] - r[3], a3i = m[2] - m[3];
+            r[0] = a0r + a2r;  m[0] = a0i + a2i;
+            r[2] = a0r - a2r;  m[2] = a0i - a2i;
+            r[1] = a1r - a3i;  m[1] = a1i + a3r;
+            r[3] = a1r + a3i;  m[3] = a1i - a3r;
+        }
+
+        bFFTStage<N, 8>::run(RealOut, ImagOut);
+    }
+};
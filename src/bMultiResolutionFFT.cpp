@@ -0,0 +1,134 @@
+#include "bMultiResolutionFFT.h"
+
+bMultiResolutionFFT::bMultiResolutionFFT()
+{
+    sampling_rate = 44100;
+    reference_size = 1024;
+    max_size = 0;
+    history_pos = 0;
+    pool = NULL;
+    input = NULL;
+    job = make_shared<bAnalyzerPool::Job>([this](int _band){
+        Band &b = bands[_band];
+        // shorter windows end earlier so all share the same centre
+        memcpy(&b.frame[0], input + (max_size-b.fft_size)/2, b.fft_size*sizeof(float));
+        b.fft->update(&b.frame[0]);
+    });
+}
+
+void bMultiResolutionFFT::setup(int _sampling_rate, int _reference_size)
+{
+    sampling_rate = _sampling_rate;
+    reference_size = _reference_size;
+    layout();
+}
+
+void bMultiResolutionFFT::addBand(float _fmin, float _fmax, int _fft_size)
+{
+    Band b{};
+    b.fmin = _fmin;
+    b.fmax = _fmax;
+    b.fft_size = _fft_size;
+    b.fft.reset(new bFFT());
+    b.fft->setup(_fft_size, sampling_rate);
+    b.fft->setOutputMask(BFFT_OUTPUT_POWER);
+    if( !b.fft->plan ){
+        return;
+    }
+    bands.push_back(move(b));
+    // ascending so the stitched column is ordered
+    sort(bands.begin(), bands.end(), [](const Band &a, const Band &b){ return a.fmin < b.fmin; });
+    layout();
+    startOwnPool();
+}
+
+void bMultiResolutionFFT::clearBands()
+{
+    bands.clear();
+    layout();
+}
+
+void bMultiResolutionFFT::setPool(bAnalyzerPool *_pool)
+{
+    pool = _pool;
+    startOwnPool();
+}
+
+void bMultiResolutionFFT::startOwnPool()
+{
+    // the calling thread takes one band itself
+    int needed = bands.size()-1;
+    if( pool != NULL || needed <= own_pool.getNumThreads() ){
+        return;
+    }
+    own_pool.stop();
+    own_pool.setup(needed);
+}
+
+int bMultiResolutionFFT::getNumBands()
+{
+    return bands.size();
+}
+
+void bMultiResolutionFFT::layout()
+{
+    max_size = 0;
+    spectrum.clear();
+    for( int i = 0; i < bands.size(); i++ ){
+        Band &b = bands[i];
+        float step = sampling_rate/(float)b.fft_size;
+        b.first_bin = max(0, (int)ceil(b.fmin/step));
+        int last_bin = min(b.fft_size/2-1, (int)ceil(b.fmax/step)-1);
+        b.num_bins = max(0, last_bin-b.first_bin+1);
+        // sine power grows with the square of the size
+        b.scale = pow(reference_size/(float)b.fft_size, 2);
+        b.frame.resize(b.fft_size);
+        max_size = max(max_size, b.fft_size);
+        for( int k = 0; k < b.num_bins; k++ ){
+            Spectrum s;
+            s.power = 0;
+            s.db = 0;
+            s.Hz = (b.first_bin+k)*step;
+            spectrum.push_back(s);
+        }
+    }
+    history.resize(2*max_size);
+    reset();
+}
+
+void bMultiResolutionFFT::reset()
+{
+    fill(history.begin(), history.end(), 0);
+    history_pos = 0;
+    for( int i = 0; i < spectrum.size(); i++ ){
+        spectrum[i].power = 0;
+        spectrum[i].db = 0;
+    }
+}
+
+void bMultiResolutionFFT::update(const float *_input, int _num_samples)
+{
+    if( bands.empty() ){
+        return;
+    }
+    for( int i = 0; i < _num_samples; i++ ){
+        history[history_pos] = history[history_pos+max_size] = _input[i];
+        if( ++history_pos == max_size ) history_pos = 0;
+    }
+
+    bAnalyzerPool *p = pool ? pool : &own_pool;
+
+    // oldest sample of the last max_size is at history_pos
+    input = &history[history_pos];
+    p->parallelFor(job, bands.size());
+
+    int n = 0;
+    for( int i = 0; i < bands.size(); i++ ){
+        Band &b = bands[i];
+        for( int k = 0; k < b.num_bins; k++, n++ ){
+            float p = b.fft->power[b.first_bin+k]*b.scale;
+            spectrum[n].power = p;
+            spectrum[n].db = 10*log10(p);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "bFFT.h"
+#include "bAnalyzerPool.h"
+
+// Several bFFTs of different sizes, each covering its own frequency band,
+// e.g. 4096 points below 500 Hz, 1024 up to 4 kHz and 256 above.
+//
+// Every update() (one hop) runs all bands in parallel on a pool and
+// stitches their bins into one column, ascending in Hz. The windows are
+// centred on the same instant (the centre of the longest one), so the
+// column is time aligned. Powers are scaled to what a _reference_size
+// point FFT would give for a sine, so bands of different sizes match.
+class bMultiResolutionFFT{
+public:
+    bMultiResolutionFFT();
+
+    void setup(int _sampling_rate, int _reference_size);
+    // bands should not overlap; _fft_size is a power of two
+    void addBand(float _fmin, float _fmax, int _fft_size);
+    void clearBands();
+    // runs the bands on _pool. without one a private pool is started by
+    // addBand, never from update().
+    void setPool(bAnalyzerPool *_pool);
+    int getNumBands();
+    // clears the input history, as after setup
+    void reset();
+
+    // waits for all bands, so call it from a worker (e.g. a pool stream),
+    // not from the audio callback. allocates nothing.
+    void update(const float *_input, int _num_samples);
+
+    vector<Spectrum> spectrum;
+
+private:
+    struct Band{
+        float fmin, fmax;
+        int fft_size;
+        int first_bin, num_bins;
+        float scale;
+        unique_ptr<bFFT> fft;
+        vector<float> frame;
+    };
+    void layout();
+    void startOwnPool();
+
+    int sampling_rate, reference_size;
+    vector<Band> bands;
+    int max_size;
+    // input history, written twice so the last max_size samples are contiguous
+    vector<float> history;
+    int history_pos;
+
+    bAnalyzerPool *pool;
+    bAnalyzerPool own_pool;
+    // runs band i on the last max_size samples at input, made once
+    shared_ptr<bAnalyzerPool::Job> job;
+    const float *input;
+};
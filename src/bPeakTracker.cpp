@@ -0,0 +1,229 @@
+#include "bPeakTracker.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+bPeakTracker::bPeakTracker()
+{
+    max_peaks = 8;
+    min_db = -100;
+    min_power = pow(10, min_db/10);
+    max_jump_hz = 10;
+    max_jump_ratio = 0.03f;
+    hold_frames = 2;
+    max_phase_correction = 0.25f;
+    next_id = 0;
+    previous_size = 0;
+}
+
+void bPeakTracker::setup(int _max_peaks, float _min_db)
+{
+    max_peaks = max(1, _max_peaks);
+    min_db = _min_db;
+    min_power = pow(10, min_db/10);
+    heap.reserve(max_peaks);
+    peaks.reserve(max_peaks);
+    reset();
+}
+
+void bPeakTracker::setMaxJump(float _hz, float _ratio)
+{
+    max_jump_hz = _hz;
+    max_jump_ratio = _ratio;
+}
+
+void bPeakTracker::setHoldFrames(int _frames)
+{
+    hold_frames = max(0, _frames);
+}
+
+void bPeakTracker::reset()
+{
+    peaks.clear();
+    partials.clear();
+    next_id = 0;
+    previous_size = 0;
+}
+
+void bPeakTracker::update(const vector<Spectrum> &_spectrum)
+{
+    power.resize(_spectrum.size());
+    for( int i = 0; i < _spectrum.size(); i++ ){
+        power[i] = _spectrum[i].power;
+    }
+    findPeaks(power.data(), power.size());
+    refine(_spectrum, power.data());
+    previous_size = 0;
+    track();
+}
+
+void bPeakTracker::update(bFFT &_fft, int _hop)
+{
+    int half = _fft.spectrum.size();
+    findPeaks(_fft.power, half);
+    refine(_fft.spectrum, _fft.power);
+
+    if( !(_fft.output_mask & BFFT_OUTPUT_PHASE) ){
+        previous_size = 0;
+        track();
+        return;
+    }
+    // the phase advance is unwrapped within fs/(2*_hop) of the quadratic
+    // estimate. frames further apart than one frame (dropped in between)
+    // narrow that below half a bin, too little for the estimate's error.
+    if( previous_size == _fft.bufsize && _hop > 0 && _hop <= _fft.bufsize ){
+        // bFFT phase turns backwards for a positive frequency
+        float step = _fft.getFreqStep();
+        double k = 2*M_PI*_hop/_fft.sampling_rate;
+        for( int i = 0; i < peaks.size(); i++ ){
+            bPeak &p = peaks[i];
+            double predicted = previous_phase[p.bin] - k*p.Hz;
+            double error = _fft.phase[p.bin] - predicted;
+            error -= 2*M_PI*floor(error/(2*M_PI) + 0.5);
+            float hz = p.Hz - error/k;
+            // for a steady tone the two estimates agree to a few hundredths
+            // of a bin. the unwrap range is at least half a bin either way,
+            // so a larger correction means the phase did not follow a
+            // steady sinusoid (onset, noise): keep the quadratic estimate.
+            if( fabs(hz - p.Hz) <= max_phase_correction*step ){
+                p.Hz = hz;
+            }
+        }
+    }
+    previous_phase.assign(_fft.phase, _fft.phase + half);
+    previous_size = _fft.bufsize;
+    track();
+}
+
+void bPeakTracker::findPeaks(const float *_power, int _n)
+{
+    heap.clear();
+    auto push = [this, _power](int _bin){
+        float p = _power[_bin];
+        if( heap.size() < max_peaks ){
+            heap.push_back(make_pair(p, _bin));
+            push_heap(heap.begin(), heap.end(), greater<pair<float, int> >());
+        }
+        else if( p > heap.front().first ){
+            pop_heap(heap.begin(), heap.end(), greater<pair<float, int> >());
+            heap.back() = make_pair(p, _bin);
+            push_heap(heap.begin(), heap.end(), greater<pair<float, int> >());
+        }
+    };
+
+    // local maxima above the threshold, the edges have no neighbour
+    int i = 1;
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 threshold = _mm_set1_ps(min_power);
+    for( ; i+5 <= _n; i += 4 ){
+        __m128 c = _mm_loadu_ps(_power+i);
+        __m128 m = _mm_and_ps(_mm_cmpgt_ps(c, _mm_loadu_ps(_power+i-1)), _mm_cmpge_ps(c, _mm_loadu_ps(_power+i+1)));
+        int bits = _mm_movemask_ps(_mm_and_ps(m, _mm_cmpgt_ps(c, threshold)));
+        for( int b = 0; bits; b++, bits >>= 1 ){
+            if( bits & 1 ) push(i+b);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t threshold = vdupq_n_f32(min_power);
+    uint32x4_t lanes = { 1, 2, 4, 8 };
+    for( ; i+5 <= _n; i += 4 ){
+        float32x4_t c = vld1q_f32(_power+i);
+        uint32x4_t m = vandq_u32(vcgtq_f32(c, vld1q_f32(_power+i-1)), vcgeq_f32(c, vld1q_f32(_power+i+1)));
+        int bits = vaddvq_u32(vandq_u32(vandq_u32(m, vcgtq_f32(c, threshold)), lanes));
+        for( int b = 0; bits; b++, bits >>= 1 ){
+            if( bits & 1 ) push(i+b);
+        }
+    }
+#endif
+    for( ; i+1 < _n; i++ ){
+        float c = _power[i];
+        if( c > _power[i-1] && c >= _power[i+1] && c > min_power ){
+            push(i);
+        }
+    }
+    sort_heap(heap.begin(), heap.end(), greater<pair<float, int> >());
+}
+
+void bPeakTracker::refine(const vector<Spectrum> &_spectrum, const float *_power)
+{
+    peaks.clear();
+    for( int i = 0; i < heap.size(); i++ ){
+        int k = heap[i].second;
+        // parabola through the log power of the peak and its neighbours
+        float a = log(max(_power[k-1], 1e-30f));
+        float b = log(max(_power[k], 1e-30f));
+        float c = log(max(_power[k+1], 1e-30f));
+        float d = a - 2*b + c;
+        float offset = d < 0 ? ofClamp(0.5f*(a-c)/d, -0.5f, 0.5f) : 0;
+        float step = offset >= 0 ? _spectrum[k+1].Hz - _spectrum[k].Hz : _spectrum[k].Hz - _spectrum[k-1].Hz;
+        bPeak p;
+        p.Hz = _spectrum[k].Hz + offset*step;
+        p.power = exp(b - 0.25f*(a-c)*offset);
+        p.db = 10*log10(p.power);
+        p.bin = k;
+        p.partial = -1;
+        peaks.push_back(p);
+    }
+}
+
+void bPeakTracker::track()
+{
+    // every close enough (peak, partial) pair, nearest first
+    pairs.clear();
+    for( int i = 0; i < peaks.size(); i++ ){
+        for( int j = 0; j < partials.size(); j++ ){
+            float d = fabs(peaks[i].Hz - partials[j].Hz);
+            if( d <= max(max_jump_hz, max_jump_ratio*partials[j].Hz) ){
+                pairs.push_back(make_pair(d, make_pair(i, j)));
+            }
+        }
+    }
+    sort(pairs.begin(), pairs.end());
+    peak_used.assign(peaks.size(), false);
+    partial_used.assign(partials.size(), false);
+    for( int n = 0; n < pairs.size(); n++ ){
+        int i = pairs[n].second.first;
+        int j = pairs[n].second.second;
+        if( peak_used[i] || partial_used[j] ){
+            continue;
+        }
+        peak_used[i] = partial_used[j] = true;
+        bPartial &q = partials[j];
+        q.Hz = peaks[i].Hz;
+        q.power = peaks[i].power;
+        q.db = peaks[i].db;
+        q.missed = 0;
+        peaks[i].partial = q.id;
+    }
+
+    // age everything, drop partials not seen for too long
+    int n = 0;
+    for( int j = 0; j < partials.size(); j++ ){
+        bPartial q = partials[j];
+        q.age++;
+        if( !partial_used[j] && ++q.missed > hold_frames ){
+            continue;
+        }
+        partials[n++] = q;
+    }
+    partials.resize(n);
+
+    for( int i = 0; i < peaks.size(); i++ ){
+        if( peak_used[i] ){
+            continue;
+        }
+        bPartial q;
+        q.id = next_id++;
+        q.Hz = peaks[i].Hz;
+        q.power = peaks[i].power;
+        q.db = peaks[i].db;
+        q.age = 0;
+        q.missed = 0;
+        peaks[i].partial = q.id;
+        partials.push_back(q);
+    }
+    sort(partials.begin(), partials.end(), [](const bPartial &a, const bPartial &b){ return a.Hz < b.Hz; });
+}
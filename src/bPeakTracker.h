@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ofMain.h"
+#include "bFFT.h"
+
+// One spectral peak of the current frame.
+struct bPeak{
+    float Hz;       // interpolated frequency
+    float power;    // interpolated power
+    float db;
+    int bin;        // local maximum it was refined from
+    int partial;    // id of the partial it belongs to
+};
+
+// A peak followed from frame to frame.
+struct bPartial{
+    int id;         // unique for the lifetime of the tracker
+    float Hz;
+    float power;
+    float db;
+    int age;        // frames since it started
+    int missed;     // consecutive frames without a peak, 0 when seen this frame
+};
+
+// Picks the strongest local maxima of a spectrum and links them into
+// partial tracks, e.g. the harmonics of a rotating machine.
+//
+// Local maxima are found in one SIMD pass over the power and the top K
+// are kept in a heap. Each is refined by quadratic interpolation of the
+// log power; when the bFFT also computes phase (BFFT_OUTPUT_PHASE), the
+// phase advance since the previous update refines it further (phase
+// vocoder), which is accurate to a small fraction of a bin for steady
+// tones. Peaks continue the nearest partial within the allowed jump, the
+// closest pairs first; the rest start new partials.
+class bPeakTracker{
+public:
+    bPeakTracker();
+
+    // at most _max_peaks per frame, none below _min_db (in the units of the
+    // spectrum, bFFT power is not normalised)
+    void setup(int _max_peaks, float _min_db = -100);
+    // a peak continues a partial when within max(_hz, _ratio*Hz) of it
+    void setMaxJump(float _hz, float _ratio = 0.03f);
+    // frames a partial survives without a peak before it ends
+    void setHoldFrames(int _frames);
+    void reset();
+
+    // any spectrum ascending in Hz (bFFT, zoom or multi-resolution)
+    void update(const vector<Spectrum> &_spectrum);
+    // _hop is the number of samples between this and the previous update,
+    // 0 when unknown. the phase step is used only for 0 < _hop <= bufsize.
+    void update(bFFT &_fft, int _hop);
+
+    // this frame, strongest first
+    vector<bPeak> peaks;
+    // live partials ascending in Hz, including the ones currently held
+    vector<bPartial> partials;
+
+private:
+    void findPeaks(const float *_power, int _n);
+    void refine(const vector<Spectrum> &_spectrum, const float *_power);
+    void track();
+
+    int max_peaks;
+    float min_db, min_power;
+    float max_jump_hz, max_jump_ratio;
+    int hold_frames;
+    // largest phase vocoder correction accepted, in bins
+    float max_phase_correction;
+    int next_id;
+    // candidates as (power, bin), a min-heap of at most max_peaks
+    vector<pair<float, int> > heap;
+    vector<float> power;
+    // (distance, peak, partial) pairs for matching
+    vector<pair<float, pair<int, int> > > pairs;
+    vector<bool> peak_used, partial_used;
+    // phase of the previous bFFT update, for the phase vocoder
+    vector<float> previous_phase;
+    int previous_size;
+};
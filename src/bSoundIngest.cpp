@@ -0,0 +1,222 @@
+#include "bSoundIngest.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define BSOUNDINGEST_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define BSOUNDINGEST_NEON
+#include <arm_neon.h>
+#endif
+
+//--------------------------------------------------------------
+// conversions
+//--------------------------------------------------------------
+void bSoundIngest_Int16ToFloat(const int16_t *_in, float *_out, int _n)
+{
+    const float scale = 1.0f/32768.0f;
+    int i = 0;
+#if defined(BSOUNDINGEST_SSE2)
+    __m128 s = _mm_set1_ps(scale);
+    for( ; i+8 <= _n; i += 8 ){
+        __m128i v = _mm_loadu_si128((const __m128i *)(_in+i));
+        // duplicate into both halves of 32 bits, arithmetic shift sign extends
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(_out+i, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+        _mm_storeu_ps(_out+i+4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+    }
+#elif defined(BSOUNDINGEST_NEON)
+    float32x4_t s = vdupq_n_f32(scale);
+    for( ; i+8 <= _n; i += 8 ){
+        int16x8_t v = vld1q_s16(_in+i);
+        vst1q_f32(_out+i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), s));
+        vst1q_f32(_out+i+4, vmulq_f32(vcvtq_f32_s32(vmovl_high_s16(v)), s));
+    }
+#endif
+    for( ; i < _n; i++ ){
+        _out[i] = _in[i]*scale;
+    }
+}
+
+void bSoundIngest_Int24ToFloat(const uint8_t *_in, float *_out, int _n)
+{
+    // samples are placed in the top 24 bits of an int32
+    const float scale = 1.0f/2147483648.0f;
+    int i = 0;
+#if defined(BSOUNDINGEST_SSE2) && defined(__SSSE3__)
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m128 s = _mm_set1_ps(scale);
+    // each load reads 16 bytes for 4 samples (12 bytes), stop before the end
+    for( ; i+6 <= _n; i += 4 ){
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(_in+3*i)), shuffle);
+        _mm_storeu_ps(_out+i, _mm_mul_ps(_mm_cvtepi32_ps(v), s));
+    }
+#elif defined(BSOUNDINGEST_NEON)
+    // sign extended 24 bit value: (signed high byte << 16) | low 16 bits
+    float32x4_t s = vdupq_n_f32(1.0f/8388608.0f);
+    for( ; i+8 <= _n; i += 8 ){
+        uint8x8x3_t b = vld3_u8(_in+3*i);
+        uint16x8_t lo = vorrq_u16(vmovl_u8(b.val[0]), vshll_n_u8(b.val[1], 8));
+        int16x8_t hi = vmovl_s8(vreinterpret_s8_u8(b.val[2]));
+        int32x4_t v0 = vorrq_s32(vshll_n_s16(vget_low_s16(hi), 16), vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lo))));
+        int32x4_t v1 = vorrq_s32(vshll_n_s16(vget_high_s16(hi), 16), vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(lo))));
+        vst1q_f32(_out+i, vmulq_f32(vcvtq_f32_s32(v0), s));
+        vst1q_f32(_out+i+4, vmulq_f32(vcvtq_f32_s32(v1), s));
+    }
+#endif
+    for( ; i < _n; i++ ){
+        const uint8_t *b = _in+3*i;
+        int32_t v = (int32_t)(((uint32_t)b[0] << 8) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 24));
+        _out[i] = v*scale;
+    }
+}
+
+void bSoundIngest_Int32ToFloat(const int32_t *_in, float *_out, int _n)
+{
+    const float scale = 1.0f/2147483648.0f;
+    int i = 0;
+#if defined(BSOUNDINGEST_SSE2)
+    __m128 s = _mm_set1_ps(scale);
+    for( ; i+4 <= _n; i += 4 ){
+        __m128i v = _mm_loadu_si128((const __m128i *)(_in+i));
+        _mm_storeu_ps(_out+i, _mm_mul_ps(_mm_cvtepi32_ps(v), s));
+    }
+#elif defined(BSOUNDINGEST_NEON)
+    float32x4_t s = vdupq_n_f32(scale);
+    for( ; i+4 <= _n; i += 4 ){
+        vst1q_f32(_out+i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(_in+i)), s));
+    }
+#endif
+    for( ; i < _n; i++ ){
+        _out[i] = _in[i]*scale;
+    }
+}
+
+void bSoundIngest_Deinterleave(const float *_in, int _num_frames, int _num_channels, float **_out, int _num_out)
+{
+    if( _num_channels == 1 ){
+        memcpy(_out[0], _in, _num_frames*sizeof(float));
+        return;
+    }
+    int i = 0;
+    if( _num_channels == 2 ){
+        float *l = _out[0];
+        float *r = _num_out > 1 ? _out[1] : NULL;
+#if defined(BSOUNDINGEST_SSE2)
+        for( ; i+4 <= _num_frames; i += 4 ){
+            __m128 a = _mm_loadu_ps(_in+2*i);
+            __m128 b = _mm_loadu_ps(_in+2*i+4);
+            _mm_storeu_ps(l+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            if( r ) _mm_storeu_ps(r+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+#elif defined(BSOUNDINGEST_NEON)
+        for( ; i+4 <= _num_frames; i += 4 ){
+            float32x4x2_t v = vld2q_f32(_in+2*i);
+            vst1q_f32(l+i, v.val[0]);
+            if( r ) vst1q_f32(r+i, v.val[1]);
+        }
+#endif
+        for( ; i < _num_frames; i++ ){
+            l[i] = _in[2*i];
+            if( r ) r[i] = _in[2*i+1];
+        }
+        return;
+    }
+    // any other layout: one pass over the frames
+    for( ; i < _num_frames; i++ ){
+        const float *frame = _in + (size_t)i*_num_channels;
+        for( int c = 0; c < _num_out; c++ ){
+            _out[c][i] = frame[c];
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// bSoundIngest
+//--------------------------------------------------------------
+bSoundIngest::bSoundIngest()
+{
+    max_frames = 0;
+    num_channels = 0;
+    stride = 0;
+    planar = NULL;
+}
+
+void bSoundIngest::setup(int _max_frames, int _num_channels)
+{
+    max_frames = _max_frames;
+    num_channels = max(1, _num_channels);
+    // keep every channel on a 32 byte boundary
+    stride = (max_frames+7) & ~7;
+    storage.assign((size_t)stride*num_channels + 8, 0);
+    uintptr_t p = (uintptr_t)&storage[0];
+    planar = (float *)((p + 31) & ~(uintptr_t)31);
+    scratch.assign(max(1024, min(max_frames*num_channels, 8192)), 0);
+}
+
+int bSoundIngest::ingest(const void *_samples, int _format, int _num_frames, int _num_channels)
+{
+    if( planar == NULL || _num_channels <= 0 ){
+        return 0;
+    }
+    int frames = min(_num_frames, max_frames);
+    int channels = min(_num_channels, num_channels);
+    float *out[64];
+    channels = min(channels, 64);
+    for( int c = 0; c < channels; c++ ){
+        out[c] = planar + (size_t)c*stride;
+    }
+
+    if( _format == OFXBSU_SAMPLE_FORMAT_FLOAT32 ){
+        bSoundIngest_Deinterleave((const float *)_samples, frames, _num_channels, out, channels);
+        return frames;
+    }
+
+    if( _num_channels == 1 ){
+        // mono converts straight into the channel
+        return convert(_samples, _format, out[0], frames) ? frames : 0;
+    }
+    // otherwise through the interleaved scratch, a cache sized chunk at a time
+    int chunk = max(1, (int)(scratch.size()/_num_channels));
+    int bytes_per_frame = _num_channels*(_format == OFXBSU_SAMPLE_FORMAT_INT16 ? 2 : _format == OFXBSU_SAMPLE_FORMAT_INT24 ? 3 : 4);
+    for( int done = 0; done < frames; done += chunk ){
+        int n = min(chunk, frames-done);
+        if( !convert((const uint8_t *)_samples + (size_t)done*bytes_per_frame, _format, &scratch[0], n*_num_channels) ){
+            return 0;
+        }
+        float *dst[64];
+        for( int c = 0; c < channels; c++ ){
+            dst[c] = out[c] + done;
+        }
+        bSoundIngest_Deinterleave(&scratch[0], n, _num_channels, dst, channels);
+    }
+    return frames;
+}
+
+bool bSoundIngest::convert(const void *_in, int _format, float *_out, int _n)
+{
+    switch( _format ){
+        case OFXBSU_SAMPLE_FORMAT_INT16: bSoundIngest_Int16ToFloat((const int16_t *)_in, _out, _n); return true;
+        case OFXBSU_SAMPLE_FORMAT_INT24: bSoundIngest_Int24ToFloat((const uint8_t *)_in, _out, _n); return true;
+        case OFXBSU_SAMPLE_FORMAT_INT32: bSoundIngest_Int32ToFloat((const int32_t *)_in, _out, _n); return true;
+    }
+    return false;
+}
+
+float *bSoundIngest::getChannel(int _channel)
+{
+    return planar + (size_t)_channel*stride;
+}
+
+int bSoundIngest::getNumChannels()
+{
+    return num_channels;
+}
+
+int bSoundIngest::getMaxFrames()
+{
+    return max_frames;
+}
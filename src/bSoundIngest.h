@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+#include "bSoundSource.h"
+
+// Input stage of ofxbSoundUtils: interleaved float/int16/int24/int32
+// blocks in, one aligned float buffer per channel out.
+//
+// Float input is deinterleaved in one pass (SSE or NEON for mono and
+// stereo). Integer input is converted with SIMD; mono goes straight into
+// the channel buffer, more channels are converted into a small scratch
+// block a chunk at a time and then deinterleaved while it is still in cache.
+// Nothing allocates after setup, so ingest() is safe on the audio thread.
+class bSoundIngest{
+public:
+    bSoundIngest();
+
+    void setup(int _max_frames, int _num_channels);
+    // copies min(_num_frames, max frames) frames of the first
+    // min(_num_channels, setup channels) channels, returns the frame count.
+    // _format is an OFXBSU_SAMPLE_FORMAT_*; int24 is packed little endian.
+    int ingest(const void *_samples, int _format, int _num_frames, int _num_channels);
+
+    float *getChannel(int _channel);
+    int getNumChannels();
+    int getMaxFrames();
+
+private:
+    bool convert(const void *_in, int _format, float *_out, int _n);
+
+    int max_frames, num_channels, stride;
+    vector<float> storage;      // channels, each stride floats, 32 byte aligned
+    float *planar;
+    vector<float> scratch;      // interleaved floats for multi-channel integers, at most 32 KB
+};
+
+// Contiguous conversions to float in [-1, 1), SIMD where available.
+void bSoundIngest_Int16ToFloat(const int16_t *_in, float *_out, int _n);
+void bSoundIngest_Int24ToFloat(const uint8_t *_in, float *_out, int _n);
+void bSoundIngest_Int32ToFloat(const int32_t *_in, float *_out, int _n);
+// _in has _num_channels interleaved channels, the first _num_out go to _out[c]
+void bSoundIngest_Deinterleave(const float *_in, int _num_frames, int _num_channels, float **_out, int _num_out);
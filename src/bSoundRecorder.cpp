@@ -0,0 +1,348 @@
+#include "bSoundRecorder.h"
+
+static void bSoundRecorder_PutLE16(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void bSoundRecorder_PutLE32(unsigned char *p, uint64_t v)
+{
+    // sizes over 4 GB do not fit, rotate before that
+    unsigned int u = (unsigned int)min(v, (uint64_t)0xFFFFFFFF);
+    p[0] = u & 0xFF;
+    p[1] = (u >> 8) & 0xFF;
+    p[2] = (u >> 16) & 0xFF;
+    p[3] = (u >> 24) & 0xFF;
+}
+
+bSoundRecorder::bSoundRecorder()
+{
+    sampling_rate = 0;
+    num_channels = 0;
+    format = 0;
+    block_frames = 0;
+    bytes_per_sample = 0;
+    block_bytes = 0;
+    num_blocks = 0;
+    pre_blocks = 0;
+    head = 0;
+    tail = 0;
+    trigger_start = 0;
+    trigger_end = 0;
+    record_start = 0;
+    record_end = 0;
+    continuous = false;
+    blocks_dropped = 0;
+    blocks_rejected = 0;
+    blocks_written = 0;
+    files_written = 0;
+    rotate_frames = 0;
+    running = false;
+    pushing = 0;
+    recording = false;
+    prefix = "recording_";
+    file_type = BSOUNDRECORDER_FILE_WAV;
+    file = NULL;
+    open_type = BSOUNDRECORDER_FILE_WAV;
+    file_frames = 0;
+}
+
+bSoundRecorder::~bSoundRecorder()
+{
+    close();
+}
+
+bool bSoundRecorder::setup(int _sampling_rate, int _num_channels, int _format, int _block_frames,
+                           float _pre_trigger_seconds, float _buffer_seconds)
+{
+    close();
+    switch( _format ){
+        case OFXBSU_SAMPLE_FORMAT_FLOAT32: bytes_per_sample = 4; break;
+        case OFXBSU_SAMPLE_FORMAT_INT16: bytes_per_sample = 2; break;
+        case OFXBSU_SAMPLE_FORMAT_INT24: bytes_per_sample = 3; break;
+        case OFXBSU_SAMPLE_FORMAT_INT32: bytes_per_sample = 4; break;
+        default:
+            ofLogError("bSoundRecorder") << "unknown sample format " << _format;
+            return false;
+    }
+    if( _sampling_rate <= 0 || _num_channels <= 0 || _block_frames <= 0 ){
+        ofLogError("bSoundRecorder") << "invalid setup: " << _sampling_rate << " Hz, " << _num_channels << " ch, " << _block_frames << " frames";
+        return false;
+    }
+    sampling_rate = _sampling_rate;
+    num_channels = _num_channels;
+    format = _format;
+    block_frames = _block_frames;
+    block_bytes = (size_t)block_frames*num_channels*bytes_per_sample;
+
+    double block_seconds = block_frames/(double)sampling_rate;
+    pre_blocks = (int)ceil(max(0.0f, _pre_trigger_seconds)/block_seconds);
+    num_blocks = pre_blocks + max(2, (int)ceil(_buffer_seconds/block_seconds));
+    ring.assign(num_blocks*block_bytes, 0);
+    ring_frames.assign(num_blocks, 0);
+
+    head = 0;
+    tail = 0;
+    trigger_start = 0;
+    trigger_end = 0;
+    record_start = 0;
+    record_end = 0;
+    blocks_dropped = 0;
+    blocks_rejected = 0;
+    blocks_written = 0;
+    running = true;
+    writer = thread(&bSoundRecorder::threadedFunction, this);
+    return true;
+}
+
+void bSoundRecorder::close()
+{
+    if( !running ){
+        return;
+    }
+    running = false;
+    // a push() that saw running still set finishes before the ring can be
+    // reassigned; later ones see it cleared and return
+    while( pushing.load() > 0 ){
+        this_thread::yield();
+    }
+    if( writer.joinable() ){
+        writer.join();
+    }
+}
+
+void bSoundRecorder::setFile(string _prefix, int _file_type)
+{
+    lock_guard<mutex> lock(file_mutex);
+    prefix = _prefix;
+    file_type = _file_type;
+}
+
+void bSoundRecorder::setRotation(float _seconds)
+{
+    rotate_frames = (uint64_t)(max(0.0f, _seconds)*sampling_rate);
+}
+
+void bSoundRecorder::startRecording()
+{
+    // the pre-trigger blocks still in the ring are not part of it
+    uint64_t h = head.load(memory_order_acquire);
+    record_start = h;
+    record_end = h;
+    continuous = true;
+}
+
+void bSoundRecorder::stopRecording()
+{
+    // blocks pushed so far still go to the file
+    record_end = head.load(memory_order_acquire);
+    continuous = false;
+}
+
+void bSoundRecorder::trigger(float _post_seconds)
+{
+    if( !running ){
+        return;
+    }
+    uint64_t h = head.load(memory_order_acquire);
+    uint64_t end = h + (uint64_t)ceil(max(0.0f, _post_seconds)*sampling_rate/block_frames);
+    uint64_t e = trigger_end.load();
+    // a new event, not the extension of one still being written
+    if( e < h ){
+        trigger_start = h > (uint64_t)pre_blocks ? h - pre_blocks : 0;
+    }
+    while( e < end && !trigger_end.compare_exchange_weak(e, end) ){
+    }
+}
+
+bool bSoundRecorder::push(const void *_samples, int _format, int _num_frames, int _num_channels)
+{
+    // counted before running is read, so close() can wait for it
+    pushing.fetch_add(1);
+    bool pushed = running.load() && pushBlock(_samples, _format, _num_frames, _num_channels);
+    pushing.fetch_sub(1, memory_order_release);
+    return pushed;
+}
+
+bool bSoundRecorder::pushBlock(const void *_samples, int _format, int _num_frames, int _num_channels)
+{
+    if( _format != format || _num_channels != num_channels ){
+        blocks_rejected.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    uint64_t h = head.load(memory_order_relaxed);
+    if( h - tail.load(memory_order_acquire) >= (uint64_t)num_blocks ){
+        blocks_dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    int frames = min(_num_frames, block_frames);
+    int slot = (int)(h % num_blocks);
+    memcpy(&ring[slot*block_bytes], _samples, (size_t)frames*num_channels*bytes_per_sample);
+    ring_frames[slot] = frames;
+    head.store(h+1, memory_order_release);
+    return true;
+}
+
+bool bSoundRecorder::isRecording()
+{
+    return recording;
+}
+
+unsigned long bSoundRecorder::getBlocksDropped()
+{
+    return blocks_dropped.load(memory_order_relaxed);
+}
+
+unsigned long bSoundRecorder::getBlocksRejected()
+{
+    return blocks_rejected.load(memory_order_relaxed);
+}
+
+unsigned long bSoundRecorder::getBlocksWritten()
+{
+    return blocks_written.load(memory_order_relaxed);
+}
+
+int bSoundRecorder::getFilesWritten()
+{
+    return files_written;
+}
+
+string bSoundRecorder::getLastFile()
+{
+    lock_guard<mutex> lock(file_mutex);
+    return last_file;
+}
+
+void bSoundRecorder::threadedFunction()
+{
+    // poll at about twice the block rate, the audio thread never signals
+    int sleep_ms = (int)ofClamp(500.0f*block_frames/sampling_rate, 1.0f, 50.0f);
+    while( running ){
+        if( !writePending(false) ){
+            this_thread::sleep_for(chrono::milliseconds(sleep_ms));
+        }
+    }
+    writePending(true);
+    closeFile();
+}
+
+bool bSoundRecorder::writePending(bool _final)
+{
+    bool wrote = false;
+    uint64_t h = head.load(memory_order_acquire);
+    uint64_t t = tail.load(memory_order_relaxed);
+    while( t < h ){
+        // [record_start, record_end) while stopped, everything from
+        // record_start while recording
+        bool recorded = t >= record_start.load(memory_order_acquire) &&
+                        (continuous || t < record_end.load(memory_order_acquire));
+        bool triggered = t < trigger_end.load(memory_order_acquire);
+        if( !recorded && !triggered ){
+            closeFile();
+            // idle: keep the last pre-trigger blocks, drop older ones
+            if( !_final && !continuous && h - t <= (uint64_t)pre_blocks ){
+                break;
+            }
+            tail.store(++t, memory_order_release);
+            continue;
+        }
+        if( file == NULL ){
+            // a triggered file starts pre_blocks before the event
+            if( !recorded && t < trigger_start.load() ){
+                tail.store(++t, memory_order_release);
+                continue;
+            }
+            if( !openFile() ){
+                // give up on this recording rather than retrying every block
+                continuous = false;
+                record_end = t;
+                trigger_end = t;
+                continue;
+            }
+        }
+        else if( continuous && rotate_frames > 0 && file_frames >= rotate_frames ){
+            closeFile();
+            if( !openFile() ){
+                continuous = false;
+                continue;
+            }
+        }
+        int slot = (int)(t % num_blocks);
+        int frames = ring_frames[slot];
+        fwrite(&ring[slot*block_bytes], 1, (size_t)frames*num_channels*bytes_per_sample, file);
+        file_frames += frames;
+        blocks_written.fetch_add(1, memory_order_relaxed);
+        tail.store(++t, memory_order_release);
+        wrote = true;
+    }
+    // stopped or trigger done, close without waiting for the next block
+    if( file != NULL && !continuous && t >= record_end.load(memory_order_acquire) &&
+        t >= trigger_end.load(memory_order_acquire) ){
+        closeFile();
+    }
+    return wrote;
+}
+
+bool bSoundRecorder::openFile()
+{
+    string path;
+    {
+        lock_guard<mutex> lock(file_mutex);
+        open_type = file_type;
+        path = ofToDataPath(prefix + ofGetTimestampString() + (open_type == BSOUNDRECORDER_FILE_WAV ? ".wav" : ".raw"), true);
+    }
+    file = fopen(path.c_str(), "wb");
+    if( file == NULL ){
+        ofLogError("bSoundRecorder") << "could not open " << path;
+        return false;
+    }
+    file_frames = 0;
+    if( open_type == BSOUNDRECORDER_FILE_WAV ){
+        // sizes are filled in by closeFile()
+        unsigned char header[44];
+        int block_align = num_channels*bytes_per_sample;
+        memcpy(header, "RIFF", 4);
+        bSoundRecorder_PutLE32(header+4, 36);
+        memcpy(header+8, "WAVEfmt ", 8);
+        bSoundRecorder_PutLE32(header+16, 16);
+        bSoundRecorder_PutLE16(header+20, format == OFXBSU_SAMPLE_FORMAT_FLOAT32 ? 3 : 1);
+        bSoundRecorder_PutLE16(header+22, num_channels);
+        bSoundRecorder_PutLE32(header+24, sampling_rate);
+        bSoundRecorder_PutLE32(header+28, (uint64_t)sampling_rate*block_align);
+        bSoundRecorder_PutLE16(header+32, block_align);
+        bSoundRecorder_PutLE16(header+34, bytes_per_sample*8);
+        memcpy(header+36, "data", 4);
+        bSoundRecorder_PutLE32(header+40, 0);
+        fwrite(header, 1, sizeof(header), file);
+    }
+    recording = true;
+    lock_guard<mutex> lock(file_mutex);
+    last_file = path;
+    return true;
+}
+
+void bSoundRecorder::closeFile()
+{
+    if( file == NULL ){
+        return;
+    }
+    if( open_type == BSOUNDRECORDER_FILE_WAV ){
+        uint64_t data_bytes = file_frames*num_channels*bytes_per_sample;
+        if( data_bytes & 1 ){
+            fputc(0, file);
+        }
+        unsigned char size[4];
+        bSoundRecorder_PutLE32(size, 36 + data_bytes + (data_bytes & 1));
+        fseek(file, 4, SEEK_SET);
+        fwrite(size, 1, 4, file);
+        bSoundRecorder_PutLE32(size, data_bytes);
+        fseek(file, 40, SEEK_SET);
+        fwrite(size, 1, 4, file);
+    }
+    fclose(file);
+    file = NULL;
+    files_written++;
+    recording = false;
+}
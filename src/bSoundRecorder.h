@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ofMain.h"
+#include "bSoundSource.h"
+#include <atomic>
+#include <thread>
+
+#define BSOUNDRECORDER_FILE_WAV 1
+#define BSOUNDRECORDER_FILE_RAW 2
+
+// Writes the raw input blocks to disk without blocking the audio thread.
+//
+// push() copies each block into a ring allocated in setup() and returns;
+// a full ring drops the block and counts it. A writer thread streams the
+// blocks to WAV or headerless raw files, either continuously (with
+// rotation) or around a trigger(). While idle the ring keeps the last
+// pre-trigger seconds, so a triggered file starts before the event.
+class bSoundRecorder{
+public:
+    bSoundRecorder();
+    ~bSoundRecorder();
+
+    // blocks of up to _block_frames interleaved frames in _format
+    // (OFXBSU_SAMPLE_FORMAT_*). the ring holds _pre_trigger_seconds plus
+    // _buffer_seconds of slack for the writer. starts the writer thread.
+    // safe while attached: push() drops blocks until the new ring is ready.
+    bool setup(int _sampling_rate, int _num_channels, int _format, int _block_frames,
+               float _pre_trigger_seconds = 5, float _buffer_seconds = 2);
+    // writes what is pending, then stops the writer
+    void close();
+
+    // files are _prefix + timestamp + ".wav"/".raw", relative to data/
+    void setFile(string _prefix, int _file_type = BSOUNDRECORDER_FILE_WAV);
+    // continuous recording starts a new file every _seconds, 0 never
+    void setRotation(float _seconds);
+    // writes the blocks pushed from now on, without the pre-trigger ones
+    void startRecording();
+    // blocks pushed before the call are still written
+    void stopRecording();
+    // saves the pre-trigger seconds before now and _post_seconds after it
+    // to one file. a trigger while that file is open extends it.
+    // safe from any thread, including the audio thread.
+    void trigger(float _post_seconds);
+
+    // audio thread: copies one block, false when dropped or rejected
+    bool push(const void *_samples, int _format, int _num_frames, int _num_channels);
+
+    bool isRecording();
+    unsigned long getBlocksDropped();   // ring full
+    unsigned long getBlocksRejected();  // format or channels differ from setup
+    unsigned long getBlocksWritten();
+    int getFilesWritten();
+    string getLastFile();
+
+private:
+    bool pushBlock(const void *_samples, int _format, int _num_frames, int _num_channels);
+    void threadedFunction();
+    bool writePending(bool _final);
+    bool openFile();
+    void closeFile();
+
+    int sampling_rate, num_channels, format, block_frames;
+    int bytes_per_sample;
+    size_t block_bytes;
+
+    // ring of num_blocks blocks; head is written by push(), tail by the writer
+    vector<unsigned char> ring;
+    vector<int> ring_frames;
+    int num_blocks, pre_blocks;
+    atomic<uint64_t> head, tail;
+
+    // blocks [trigger_start, trigger_end) go to a triggered file
+    atomic<uint64_t> trigger_start, trigger_end;
+    // blocks [record_start, record_end) go to a continuous file, without
+    // an end while continuous is set
+    atomic<uint64_t> record_start, record_end;
+    atomic<bool> continuous;
+
+    atomic<unsigned long> blocks_dropped, blocks_rejected, blocks_written;
+    atomic<int> files_written;
+    atomic<uint64_t> rotate_frames;
+    atomic<bool> running, recording;
+    // push() calls in progress, close() waits for them
+    atomic<int> pushing;
+    thread writer;
+
+    // settings and name shared with the writer
+    mutex file_mutex;
+    string prefix;
+    int file_type;
+    string last_file;
+    // writer thread only
+    FILE *file;
+    int open_type;
+    uint64_t file_frames;
+};
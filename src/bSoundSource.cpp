@@ -0,0 +1,525 @@
+#include "bSoundSource.h"
+
+#ifdef TARGET_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+// bSoundSourceDevice
+//--------------------------------------------------------------
+void bSoundSourceDevice::setup(int _sampling_rate, bool _use_output)
+{
+    description = "";
+    auto devices = soundStream.getDeviceList();
+    for( int i = 0; i < devices.size(); i++ ){
+        if( devices[i].isDefaultInput ){
+            description += "Input Device: "+devices[i].name + "\n";
+            settings.setInDevice(devices[i]);
+            description += " - Configurable Sampling Rate: ";
+            for( int j = 0; j < devices[i].sampleRates.size(); j++){
+                description += ofToString(devices[i].sampleRates[j])+",";
+            }
+            if( _sampling_rate == 0 ){
+                settings.sampleRate = devices[i].sampleRates[0];
+            }
+            else{
+                settings.sampleRate = _sampling_rate;
+            }
+            settings.numInputChannels = devices[i].inputChannels;
+
+        }
+        if( devices[i].isDefaultOutput && _use_output ){
+            settings.setOutDevice(devices[i]);
+            settings.numOutputChannels = devices[i].outputChannels;
+            description += "\nOutput Device: "+devices[i].name+"\n";
+            description += " - Configurable Sampling Rate: ";
+            for( int j = 0; j < devices[i].sampleRates.size(); j++){
+                description += ofToString(devices[i].sampleRates[j])+",";
+            }
+        }
+
+    }
+}
+
+bool bSoundSourceDevice::start(int _bufsize, Callback _callback)
+{
+    callback = _callback;
+    settings.bufferSize = _bufsize;
+    settings.setInListener(this);
+    return soundStream.setup(settings);
+}
+
+void bSoundSourceDevice::stop()
+{
+    soundStream.close();
+}
+
+int bSoundSourceDevice::getSampleRate()
+{
+    return settings.sampleRate;
+}
+
+int bSoundSourceDevice::getNumChannels()
+{
+    return settings.numInputChannels;
+}
+
+string bSoundSourceDevice::getDescription()
+{
+    return description;
+}
+
+void bSoundSourceDevice::audioIn(ofSoundBuffer &input)
+{
+    if( callback ){
+        callback(&input.getBuffer()[0], OFXBSU_SAMPLE_FORMAT_FLOAT32, input.getNumFrames(), input.getNumChannels());
+    }
+}
+
+//--------------------------------------------------------------
+// bSoundSourceOffline
+//--------------------------------------------------------------
+bSoundSourceOffline::bSoundSourceOffline()
+{
+    realtime = false;
+    loop = false;
+    running = false;
+    finished = false;
+    bufsize = 0;
+}
+
+bSoundSourceOffline::~bSoundSourceOffline()
+{
+    stop();
+}
+
+void bSoundSourceOffline::setRealtime(bool _realtime)
+{
+    realtime = _realtime;
+}
+
+void bSoundSourceOffline::setLoop(bool _loop)
+{
+    loop = _loop;
+}
+
+bool bSoundSourceOffline::start(int _bufsize, Callback _callback)
+{
+    stop();
+    rewind();
+    bufsize = _bufsize;
+    callback = _callback;
+    finished = false;
+    running = true;
+    worker = thread(&bSoundSourceOffline::threadedFunction, this);
+    return true;
+}
+
+void bSoundSourceOffline::stop()
+{
+    running = false;
+    if( worker.joinable() ){
+        worker.join();
+    }
+}
+
+int bSoundSourceOffline::run(int _bufsize, Callback _callback)
+{
+    stop();
+    rewind();
+    int blocks = 0;
+    finished = false;
+    const void *samples;
+    while( (samples = next(_bufsize)) != NULL ){
+        _callback(samples, getSampleFormat(), _bufsize, getNumChannels());
+        blocks++;
+    }
+    finished = true;
+    return blocks;
+}
+
+bool bSoundSourceOffline::isFinished()
+{
+    return finished;
+}
+
+void bSoundSourceOffline::threadedFunction()
+{
+    auto period = chrono::duration<double>((double)bufsize/max(1, getSampleRate()));
+    auto deadline = chrono::steady_clock::now();
+    while( running ){
+        const void *samples = next(bufsize);
+        if( samples == NULL ){
+            if( !loop ){
+                break;
+            }
+            rewind();
+            continue;
+        }
+        callback(samples, getSampleFormat(), bufsize, getNumChannels());
+        if( realtime ){
+            deadline += chrono::duration_cast<chrono::steady_clock::duration>(period);
+            this_thread::sleep_until(deadline);
+        }
+    }
+    finished = true;
+}
+
+//--------------------------------------------------------------
+// bSoundSourceFile
+//--------------------------------------------------------------
+static int bSoundSource_ReadLE16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int bSoundSource_ReadLE32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+bSoundSourceFile::bSoundSourceFile()
+{
+    mapped = NULL;
+    mapped_size = 0;
+#ifdef TARGET_WIN32
+    file_handle = NULL;
+    mapping_handle = NULL;
+#endif
+    data = NULL;
+    sampling_rate = 0;
+    num_channels = 0;
+    format = 0;
+    bytes_per_sample = 0;
+    num_frames = 0;
+    position = 0;
+}
+
+bSoundSourceFile::~bSoundSourceFile()
+{
+    stop();
+    unmap();
+}
+
+bool bSoundSourceFile::map(string _path)
+{
+    unmap();
+    path = _path;
+    string full_path = ofToDataPath(_path, true);
+#ifdef TARGET_WIN32
+    HANDLE file = CreateFileA(full_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if( file == INVALID_HANDLE_VALUE ){
+        ofLogError("bSoundSourceFile") << "could not open " << full_path;
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if( mapping == NULL ){
+        CloseHandle(file);
+        ofLogError("bSoundSourceFile") << "could not map " << full_path;
+        return false;
+    }
+    mapped = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    mapped_size = (size_t)size.QuadPart;
+    file_handle = file;
+    mapping_handle = mapping;
+#else
+    int fd = open(full_path.c_str(), O_RDONLY);
+    if( fd < 0 ){
+        ofLogError("bSoundSourceFile") << "could not open " << full_path;
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    void *p = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if( p == MAP_FAILED ){
+        ofLogError("bSoundSourceFile") << "could not map " << full_path;
+        return false;
+    }
+    // the file is read front to back once
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    mapped = (const unsigned char *)p;
+    mapped_size = st.st_size;
+#endif
+    return mapped != NULL;
+}
+
+void bSoundSourceFile::unmap()
+{
+    if( mapped == NULL ){
+        return;
+    }
+#ifdef TARGET_WIN32
+    UnmapViewOfFile(mapped);
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+#else
+    munmap((void *)mapped, mapped_size);
+#endif
+    mapped = NULL;
+    mapped_size = 0;
+    data = NULL;
+    num_frames = 0;
+}
+
+bool bSoundSourceFile::load(string _path)
+{
+    stop();
+    if( !map(_path) ){
+        return false;
+    }
+    if( mapped_size < 12 || memcmp(mapped, "RIFF", 4) != 0 || memcmp(mapped+8, "WAVE", 4) != 0 ){
+        ofLogError("bSoundSourceFile") << _path << " is not a WAV file";
+        unmap();
+        return false;
+    }
+
+    int audio_format = 0, bits = 0;
+    size_t data_offset = 0, data_size = 0;
+    size_t p = 12;
+    while( p + 8 <= mapped_size ){
+        const unsigned char *chunk = mapped + p;
+        size_t size = bSoundSource_ReadLE32(chunk+4);
+        if( memcmp(chunk, "fmt ", 4) == 0 && p + 8 + 16 <= mapped_size ){
+            audio_format = bSoundSource_ReadLE16(chunk+8);
+            num_channels = bSoundSource_ReadLE16(chunk+10);
+            sampling_rate = bSoundSource_ReadLE32(chunk+12);
+            bits = bSoundSource_ReadLE16(chunk+22);
+            // WAVE_FORMAT_EXTENSIBLE: the real format is the start of the sub format GUID
+            if( audio_format == 0xFFFE && size >= 40 && p + 8 + 26 <= mapped_size ){
+                audio_format = bSoundSource_ReadLE16(chunk+32);
+            }
+        }
+        else if( memcmp(chunk, "data", 4) == 0 ){
+            data_offset = p + 8;
+            // streamed files may leave the size unset
+            data_size = min(size, mapped_size - data_offset);
+            break;
+        }
+        p += 8 + size + (size & 1);
+    }
+
+    if( audio_format == 3 && bits == 32 ) format = OFXBSU_SAMPLE_FORMAT_FLOAT32;
+    else if( audio_format == 1 && bits == 16 ) format = OFXBSU_SAMPLE_FORMAT_INT16;
+    else if( audio_format == 1 && bits == 24 ) format = OFXBSU_SAMPLE_FORMAT_INT24;
+    else if( audio_format == 1 && bits == 32 ) format = OFXBSU_SAMPLE_FORMAT_INT32;
+    else{
+        ofLogError("bSoundSourceFile") << _path << ": unsupported format " << audio_format << ", " << bits << " bits";
+        unmap();
+        return false;
+    }
+    if( data_offset == 0 || num_channels <= 0 ){
+        ofLogError("bSoundSourceFile") << _path << ": no audio data";
+        unmap();
+        return false;
+    }
+    bytes_per_sample = bits/8;
+    data = mapped + data_offset;
+    num_frames = (int)(data_size/(bytes_per_sample*num_channels));
+    position = 0;
+    return true;
+}
+
+bool bSoundSourceFile::loadRaw(string _path, int _sampling_rate, int _num_channels, int _format)
+{
+    stop();
+    if( !map(_path) ){
+        return false;
+    }
+    sampling_rate = _sampling_rate;
+    num_channels = _num_channels;
+    format = _format;
+    switch( format ){
+        case OFXBSU_SAMPLE_FORMAT_FLOAT32: bytes_per_sample = 4; break;
+        case OFXBSU_SAMPLE_FORMAT_INT16: bytes_per_sample = 2; break;
+        case OFXBSU_SAMPLE_FORMAT_INT24: bytes_per_sample = 3; break;
+        case OFXBSU_SAMPLE_FORMAT_INT32: bytes_per_sample = 4; break;
+        default:
+            ofLogError("bSoundSourceFile") << "unknown sample format " << format;
+            unmap();
+            return false;
+    }
+    data = mapped;
+    num_frames = (int)(mapped_size/(bytes_per_sample*num_channels));
+    position = 0;
+    return true;
+}
+
+void bSoundSourceFile::close()
+{
+    stop();
+    unmap();
+}
+
+int bSoundSourceFile::getSampleRate()
+{
+    return sampling_rate;
+}
+
+int bSoundSourceFile::getNumChannels()
+{
+    return num_channels;
+}
+
+int bSoundSourceFile::getNumFrames()
+{
+    return num_frames;
+}
+
+int bSoundSourceFile::getSampleFormat()
+{
+    return format;
+}
+
+string bSoundSourceFile::getDescription()
+{
+    return "Input File: " + path + " (" + ofToString(num_channels) + "ch, " + ofToString(num_frames) + " frames)\n";
+}
+
+void bSoundSourceFile::rewind()
+{
+    position = 0;
+}
+
+const void *bSoundSourceFile::next(int _num_frames)
+{
+    if( data == NULL || position >= num_frames ){
+        return NULL;
+    }
+    int frames = min(_num_frames, num_frames - position);
+    const unsigned char *src = data + (size_t)position*num_channels*bytes_per_sample;
+    position += frames;
+
+    // whole blocks straight from the mapping, converted by the consumer
+    if( frames == _num_frames ){
+        return src;
+    }
+    // zero pad the last, short block
+    size_t bytes = (size_t)frames*num_channels*bytes_per_sample;
+    block.assign((size_t)_num_frames*num_channels*bytes_per_sample, 0);
+    memcpy(&block[0], src, bytes);
+    return &block[0];
+}
+
+//--------------------------------------------------------------
+// bSoundSourceSynth
+//--------------------------------------------------------------
+bSoundSourceSynth::bSoundSourceSynth()
+{
+    sampling_rate = 44100;
+    num_channels = 1;
+    total_frames = 0;
+    position = 0;
+    noise_amplitude = 0;
+    noise_seed = 1;
+}
+
+void bSoundSourceSynth::setup(int _sampling_rate, int _num_channels)
+{
+    sampling_rate = _sampling_rate;
+    num_channels = _num_channels;
+    rewind();
+}
+
+void bSoundSourceSynth::setDuration(float _seconds)
+{
+    total_frames = (long)(_seconds*sampling_rate);
+}
+
+void bSoundSourceSynth::addSine(float _hz, float _amplitude)
+{
+    Sine s = { _hz, _amplitude, 0 };
+    sines.push_back(s);
+}
+
+void bSoundSourceSynth::addNoise(float _amplitude, unsigned int _seed)
+{
+    noise_amplitude = _amplitude;
+    noise_seed = _seed;
+    noise.seed(_seed);
+}
+
+void bSoundSourceSynth::addSweep(float _hz_from, float _hz_to, float _seconds, float _amplitude, bool _exponential)
+{
+    Sweep s = { _hz_from, _hz_to, _seconds, _amplitude, 0, 0, _exponential };
+    sweeps.push_back(s);
+}
+
+void bSoundSourceSynth::clear()
+{
+    sines.clear();
+    sweeps.clear();
+    noise_amplitude = 0;
+}
+
+int bSoundSourceSynth::getSampleRate()
+{
+    return sampling_rate;
+}
+
+int bSoundSourceSynth::getNumChannels()
+{
+    return num_channels;
+}
+
+string bSoundSourceSynth::getDescription()
+{
+    return "Input Synth: " + ofToString(sines.size()) + " sine, " + ofToString(sweeps.size()) + " sweep" + (noise_amplitude > 0 ? ", noise\n" : "\n");
+}
+
+void bSoundSourceSynth::rewind()
+{
+    position = 0;
+    for( int i = 0; i < sines.size(); i++ ){
+        sines[i].phase = 0;
+    }
+    for( int i = 0; i < sweeps.size(); i++ ){
+        sweeps[i].phase = 0;
+        sweeps[i].t = 0;
+    }
+    noise.seed(noise_seed);
+}
+
+const void *bSoundSourceSynth::next(int _num_frames)
+{
+    if( total_frames > 0 && position >= total_frames ){
+        return NULL;
+    }
+    position += _num_frames;
+
+    double dt = 1.0/sampling_rate;
+    block.resize((size_t)_num_frames*num_channels);
+    for( int i = 0; i < _num_frames; i++ ){
+        double v = 0;
+        for( int k = 0; k < sines.size(); k++ ){
+            Sine &s = sines[k];
+            v += s.amplitude*sin(s.phase);
+            s.phase += 2*M_PI*s.hz*dt;
+            if( s.phase > 2*M_PI ) s.phase -= 2*M_PI;
+        }
+        for( int k = 0; k < sweeps.size(); k++ ){
+            Sweep &s = sweeps[k];
+            double r = s.t/s.seconds;
+            double hz = s.exponential ? s.hz_from*pow(s.hz_to/s.hz_from, r) : s.hz_from + (s.hz_to-s.hz_from)*r;
+            v += s.amplitude*sin(s.phase);
+            s.phase += 2*M_PI*hz*dt;
+            if( s.phase > 2*M_PI ) s.phase -= 2*M_PI;
+            s.t += dt;
+            if( s.t >= s.seconds ) s.t = 0;
+        }
+        if( noise_amplitude > 0 ){
+            v += noise_amplitude*(2.0*noise()/(double)minstd_rand::max() - 1.0);
+        }
+        for( int c = 0; c < num_channels; c++ ){
+            block[i*num_channels+c] = (float)v;
+        }
+    }
+    return &block[0];
+}
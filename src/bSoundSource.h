@@ -0,0 +1,162 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+
+#define OFXBSU_SAMPLE_FORMAT_FLOAT32 1
+#define OFXBSU_SAMPLE_FORMAT_INT16 2
+#define OFXBSU_SAMPLE_FORMAT_INT24 3
+#define OFXBSU_SAMPLE_FORMAT_INT32 4
+
+// Where ofxbSoundUtils gets its samples from. A source delivers blocks of
+// bufsize interleaved frames in its native OFXBSU_SAMPLE_FORMAT_* to the
+// callback passed to start(); the pointer is only valid during the call.
+class bSoundSource{
+public:
+    typedef function<void(const void *_samples, int _format, int _num_frames, int _num_channels)> Callback;
+
+    virtual ~bSoundSource(){}
+    virtual bool start(int _bufsize, Callback _callback) = 0;
+    virtual void stop() = 0;
+    virtual int getSampleRate() = 0;
+    virtual int getNumChannels() = 0;
+    virtual int getSampleFormat(){ return OFXBSU_SAMPLE_FORMAT_FLOAT32; }
+    // false when blocks can wait for the consumer instead of being dropped
+    virtual bool isLive(){ return true; }
+    virtual string getDescription() = 0;
+};
+
+// Live input from a sound device through ofSoundStream.
+class bSoundSourceDevice : public bSoundSource{
+public:
+    // opens the system default input device, _sampling_rate 0 picks the lowest supported.
+    void setup(int _sampling_rate, bool _use_output);
+    bool start(int _bufsize, Callback _callback);
+    void stop();
+    int getSampleRate();
+    int getNumChannels();
+    string getDescription();
+    void audioIn(ofSoundBuffer &input);
+
+    ofSoundStream soundStream;
+    ofSoundStreamSettings settings;
+
+private:
+    Callback callback;
+    string description;
+};
+
+// Base of the sources that are not tied to a device clock. Blocks are
+// produced on a thread as fast as the consumer takes them, or paced to
+// real time with setRealtime(true). run() delivers every block on the
+// calling thread instead, for tests and offline batch jobs. Both start
+// from the beginning of the source.
+class bSoundSourceOffline : public bSoundSource{
+public:
+    bSoundSourceOffline();
+    virtual ~bSoundSourceOffline();
+
+    void setRealtime(bool _realtime);
+    void setLoop(bool _loop);
+    bool start(int _bufsize, Callback _callback);
+    void stop();
+    // stops the thread, rewinds and delivers every block on the calling
+    // thread until the source is exhausted. returns the number of blocks.
+    int run(int _bufsize, Callback _callback);
+    bool isLive(){ return false; }
+    bool isFinished();
+
+protected:
+    // next _num_frames interleaved frames in getSampleFormat(), or NULL at
+    // the end. may point into the source's own storage (no copy).
+    virtual const void *next(int _num_frames) = 0;
+    virtual void rewind() = 0;
+
+    bool realtime;
+    bool loop;
+
+private:
+    void threadedFunction();
+
+    thread worker;
+    atomic<bool> running;
+    atomic<bool> finished;
+    int bufsize;
+    Callback callback;
+};
+
+// WAV or headerless raw file, memory mapped. Blocks are handed to the
+// callback straight from the mapping in the file's own sample format;
+// only the last, short block is copied to pad it with silence.
+class bSoundSourceFile : public bSoundSourceOffline{
+public:
+    bSoundSourceFile();
+    ~bSoundSourceFile();
+
+    bool load(string _path);
+    bool loadRaw(string _path, int _sampling_rate, int _num_channels, int _format);
+    void close();
+    int getSampleRate();
+    int getNumChannels();
+    int getNumFrames();
+    int getSampleFormat();
+    string getDescription();
+
+protected:
+    const void *next(int _num_frames);
+    void rewind();
+
+private:
+    bool map(string _path);
+    void unmap();
+
+    string path;
+    const unsigned char *mapped;
+    size_t mapped_size;
+#ifdef TARGET_WIN32
+    void *file_handle, *mapping_handle;
+#endif
+    const unsigned char *data;
+    int sampling_rate, num_channels, format, bytes_per_sample;
+    int num_frames, position;
+    vector<unsigned char> block;
+};
+
+// Test signals: any mix of sines, white noise and sweeps.
+class bSoundSourceSynth : public bSoundSourceOffline{
+public:
+    bSoundSourceSynth();
+    ~bSoundSourceSynth(){ stop(); }
+
+    void setup(int _sampling_rate, int _num_channels = 1);
+    // 0 runs forever
+    void setDuration(float _seconds);
+    void addSine(float _hz, float _amplitude);
+    void addNoise(float _amplitude, unsigned int _seed = 1);
+    // linear or exponential sweep from _hz_from to _hz_to over _seconds, then repeats
+    void addSweep(float _hz_from, float _hz_to, float _seconds, float _amplitude, bool _exponential = false);
+    void clear();
+    int getSampleRate();
+    int getNumChannels();
+    string getDescription();
+
+protected:
+    const void *next(int _num_frames);
+    void rewind();
+
+private:
+    struct Sine{ double hz, amplitude, phase; };
+    struct Sweep{ double hz_from, hz_to, seconds, amplitude, phase, t; bool exponential; };
+
+    int sampling_rate, num_channels;
+    long total_frames, position;
+    vector<Sine> sines;
+    vector<Sweep> sweeps;
+    float noise_amplitude;
+    unsigned int noise_seed;
+    minstd_rand noise;
+    vector<float> block;
+};
@@ -0,0 +1,171 @@
+#include "bSoundStats.h"
+
+bStatsTimer::bStatsTimer()
+{
+    reset();
+}
+
+void bStatsTimer::add(uint64_t _us)
+{
+    count.fetch_add(1, memory_order_relaxed);
+    total.fetch_add(_us, memory_order_relaxed);
+    last.store(_us, memory_order_relaxed);
+    uint64_t m = maximum.load(memory_order_relaxed);
+    while( _us > m && !maximum.compare_exchange_weak(m, _us, memory_order_relaxed) ){
+    }
+}
+
+void bStatsTimer::reset()
+{
+    count = 0;
+    total = 0;
+    maximum = 0;
+    last = 0;
+}
+
+uint64_t bStatsTimer::getCount() const
+{
+    return count.load(memory_order_relaxed);
+}
+
+float bStatsTimer::getMean() const
+{
+    uint64_t c = count.load(memory_order_relaxed);
+    if( c == 0 ){
+        return 0;
+    }
+    return total.load(memory_order_relaxed)/(float)c;
+}
+
+uint64_t bStatsTimer::getMax() const
+{
+    return maximum.load(memory_order_relaxed);
+}
+
+uint64_t bStatsTimer::getLast() const
+{
+    return last.load(memory_order_relaxed);
+}
+
+bSoundStats::bSoundStats()
+{
+    period_us = 0;
+    reset();
+}
+
+void bSoundStats::setup(int _bufsize, int _sampling_rate)
+{
+    period_us = _sampling_rate > 0 ? 1000000.0f*_bufsize/_sampling_rate : 0;
+    reset();
+}
+
+void bSoundStats::reset()
+{
+    callback.reset();
+    fft.reset();
+    feature.reset();
+    update_fbo.reset();
+    for( int i = 0; i < bSoundStatsSnapshot::NUM_HISTOGRAM_BINS; i++ ){
+        callback_histogram[i] = 0;
+    }
+    last_callback_us = 0;
+    jitter_total_us = 0;
+    jitter_count = 0;
+    deadline_misses = 0;
+    xruns = 0;
+}
+
+void bSoundStats::addCallback(uint64_t _start_us, uint64_t _duration_us)
+{
+    callback.add(_duration_us);
+
+    int bin = 0;
+    for( uint64_t d = _duration_us; d > 1 && bin < bSoundStatsSnapshot::NUM_HISTOGRAM_BINS-1; d >>= 1 ){
+        bin++;
+    }
+    callback_histogram[bin].fetch_add(1, memory_order_relaxed);
+
+    if( period_us <= 0 ){
+        return;
+    }
+    if( _duration_us > period_us ){
+        deadline_misses.fetch_add(1, memory_order_relaxed);
+    }
+    // the driver calls back once per period; a gap of several periods
+    // means blocks were lost somewhere between the device and us.
+    uint64_t last = last_callback_us.exchange(_start_us, memory_order_relaxed);
+    if( last != 0 && _start_us > last ){
+        float interval = (float)(_start_us-last);
+        jitter_total_us.fetch_add((uint64_t)fabs(interval-period_us), memory_order_relaxed);
+        jitter_count.fetch_add(1, memory_order_relaxed);
+        if( interval > 1.5f*period_us ){
+            xruns.fetch_add((uint64_t)(interval/period_us+0.5f)-1, memory_order_relaxed);
+        }
+    }
+}
+
+bSoundStatsSnapshot bSoundStats::getSnapshot() const
+{
+    bSoundStatsSnapshot s;
+    s.period_us = period_us;
+    s.callbacks = callback.getCount();
+    s.callback_mean_us = callback.getMean();
+    s.callback_max_us = callback.getMax();
+    for( int i = 0; i < bSoundStatsSnapshot::NUM_HISTOGRAM_BINS; i++ ){
+        s.callback_histogram[i] = callback_histogram[i].load(memory_order_relaxed);
+    }
+    s.deadline_misses = deadline_misses.load(memory_order_relaxed);
+    uint64_t jc = jitter_count.load(memory_order_relaxed);
+    s.jitter_us = jc > 0 ? jitter_total_us.load(memory_order_relaxed)/(float)jc : 0;
+    s.xruns = xruns.load(memory_order_relaxed);
+    s.fft_mean_us = fft.getMean();
+    s.fft_max_us = fft.getMax();
+    s.feature_mean_us = feature.getMean();
+    s.feature_max_us = feature.getMax();
+    s.update_fbo_mean_us = update_fbo.getMean();
+    s.update_fbo_max_us = update_fbo.getMax();
+    s.queue_depth = 0;
+    s.queue_length = 0;
+    s.frames_dropped = 0;
+    s.recorder_dropped = 0;
+    return s;
+}
+
+void bSoundStats::draw(const bSoundStatsSnapshot &_s, int _x, int _y) const
+{
+    string str;
+    str += "Deadline: " + ofToString(_s.period_us, 0) + " us";
+    str += ", Callbacks: " + ofToString(_s.callbacks) + "\n";
+    str += "Callback: mean " + ofToString(_s.callback_mean_us, 1) + " us, max " + ofToString(_s.callback_max_us, 0) + " us";
+    str += ", late: " + ofToString(_s.deadline_misses) + "\n";
+    str += "Jitter: " + ofToString(_s.jitter_us, 1) + " us, xrun (est.): " + ofToString(_s.xruns) + "\n";
+    str += "FFT: mean " + ofToString(_s.fft_mean_us, 1) + " us, max " + ofToString(_s.fft_max_us, 0) + " us\n";
+    str += "Feature: mean " + ofToString(_s.feature_mean_us, 1) + " us, max " + ofToString(_s.feature_max_us, 0) + " us\n";
+    str += "updateFbo: mean " + ofToString(_s.update_fbo_mean_us, 1) + " us, max " + ofToString(_s.update_fbo_max_us, 0) + " us\n";
+    str += "Queue: " + ofToString(_s.queue_depth) + "/" + ofToString(_s.queue_length);
+    str += ", dropped: " + ofToString(_s.frames_dropped);
+    str += ", rec dropped: " + ofToString(_s.recorder_dropped);
+    ofDrawBitmapString(str, _x, _y);
+
+    // callback duration histogram, one bar per power of two microseconds
+    uint64_t peak = 1;
+    for( int i = 0; i < bSoundStatsSnapshot::NUM_HISTOGRAM_BINS; i++ ){
+        peak = max(peak, _s.callback_histogram[i]);
+    }
+    int bar_w = 8, bar_h = 40;
+    int y = _y + 14*8;
+    ofPushStyle();
+    ofFill();
+    for( int i = 0; i < bSoundStatsSnapshot::NUM_HISTOGRAM_BINS; i++ ){
+        float h = bar_h*_s.callback_histogram[i]/(float)peak;
+        // bins at or past the deadline are drawn red
+        if( _s.period_us > 0 && (float)(1 << i) >= _s.period_us ){
+            ofSetColor(255, 64, 64);
+        }
+        else{
+            ofSetColor(255);
+        }
+        ofDrawRectangle(_x + i*bar_w, y + bar_h - h, bar_w-1, h);
+    }
+    ofPopStyle();
+}
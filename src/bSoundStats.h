@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+
+// Running count/total/max of a timed section, in microseconds.
+// Lock-free, safe to add from any thread.
+class bStatsTimer{
+public:
+    bStatsTimer();
+    void add(uint64_t _us);
+    void reset();
+    uint64_t getCount() const;
+    float getMean() const;
+    uint64_t getMax() const;
+    uint64_t getLast() const;
+
+private:
+    atomic<uint64_t> count;
+    atomic<uint64_t> total;
+    atomic<uint64_t> maximum;
+    atomic<uint64_t> last;
+};
+
+// Copy of the counters at one point in time.
+struct bSoundStatsSnapshot{
+    static const int NUM_HISTOGRAM_BINS = 16;
+
+    float period_us;                          // audio deadline, bufsize/sampling rate
+    uint64_t callbacks;
+    float callback_mean_us, callback_max_us;
+    uint64_t callback_histogram[NUM_HISTOGRAM_BINS]; // bin i: [2^i, 2^(i+1)) us
+    uint64_t deadline_misses;                 // callbacks that took longer than a period
+    float jitter_us;                          // mean |interval - period|
+    uint64_t xruns;                           // estimated from late callbacks
+    float fft_mean_us, fft_max_us;
+    float feature_mean_us, feature_max_us;
+    float update_fbo_mean_us, update_fbo_max_us;
+    int queue_depth, queue_length;
+    unsigned long frames_dropped;
+    unsigned long recorder_dropped;           // blocks the recorder ring had no room for
+};
+
+// Hot-path counters of one ofxbSoundUtils instance.
+class bSoundStats{
+public:
+    bSoundStats();
+    void setup(int _bufsize, int _sampling_rate);
+    void reset();
+
+    // audio thread: _start_us is the callback entry time.
+    void addCallback(uint64_t _start_us, uint64_t _duration_us);
+
+    bSoundStatsSnapshot getSnapshot() const;
+    void draw(const bSoundStatsSnapshot &_snapshot, int _x, int _y) const;
+
+    bStatsTimer callback;
+    bStatsTimer fft;
+    bStatsTimer feature;
+    bStatsTimer update_fbo;
+
+private:
+    float period_us;
+    atomic<uint64_t> callback_histogram[bSoundStatsSnapshot::NUM_HISTOGRAM_BINS];
+    atomic<uint64_t> last_callback_us;
+    atomic<uint64_t> jitter_total_us;
+    atomic<uint64_t> jitter_count;
+    atomic<uint64_t> deadline_misses;
+    atomic<uint64_t> xruns;
+};
@@ -0,0 +1,224 @@
+#include "bSpectrumAverager.h"
+#include "bFastMath.h"
+
+bSpectrumAverager::bSpectrumAverager()
+{
+    num_bins = 0;
+    freq_step = 0;
+    update_seconds = 0;
+    num_updates = 0;
+    segments = 8;
+    segment_pos = 0;
+    segment_count = 0;
+    smoothing_seconds = -1;
+    smoothing_alpha = 0.9;
+    peak_decay_db = 0;
+    peak_decay = 1.0;
+    db_min = -100;
+    db_step = 1;
+    num_buckets = 240;
+    histogram_total = 0;
+}
+
+void bSpectrumAverager::setup(int _num_bins, float _freq_step, float _update_seconds)
+{
+    num_bins = _num_bins;
+    freq_step = _freq_step;
+    update_seconds = _update_seconds;
+
+    welch.resize(num_bins);
+    smoothed.resize(num_bins);
+    peak.resize(num_bins);
+    percentile.resize(num_bins);
+    for( int i = 0; i < num_bins; i++ ){
+        welch[i].Hz = smoothed[i].Hz = peak[i].Hz = percentile[i].Hz = freq_step*i;
+    }
+    setWelchSegments(segments);
+    setPercentileRange(db_min, db_min + num_buckets*db_step, db_step);
+    if( smoothing_seconds >= 0 ){
+        setSmoothing(smoothing_seconds);
+    }
+    setPeakDecay(peak_decay_db);
+    reset();
+}
+
+void bSpectrumAverager::setWelchSegments(int _segments)
+{
+    segments = max(1, _segments);
+    segment_ring.assign((size_t)segments*num_bins, 0);
+    welch_sum.assign(num_bins, 0);
+    welch_mean.assign(num_bins, 0);
+    segment_pos = 0;
+    segment_count = 0;
+}
+
+void bSpectrumAverager::setSmoothing(float _time_constant_seconds)
+{
+    smoothing_seconds = max(0.0f, _time_constant_seconds);
+    if( _time_constant_seconds <= 0 ){
+        smoothing_alpha = 0;
+        return;
+    }
+    smoothing_alpha = exp(-update_seconds/_time_constant_seconds);
+}
+
+void bSpectrumAverager::setPeakDecay(float _db_per_second)
+{
+    peak_decay_db = _db_per_second;
+    peak_decay = pow(10.0f, -_db_per_second*update_seconds/10.0f);
+}
+
+void bSpectrumAverager::setPercentileRange(float _db_min, float _db_max, float _db_step)
+{
+    db_min = _db_min;
+    db_step = _db_step;
+    num_buckets = max(1, (int)((_db_max-_db_min)/_db_step));
+    histogram.assign((size_t)num_bins*num_buckets, 0);
+    histogram_total = 0;
+}
+
+void bSpectrumAverager::reset()
+{
+    num_updates = 0;
+    setWelchSegments(segments);
+    smoothed_power.assign(num_bins, 0);
+    peak_power.assign(num_bins, 0);
+    fill(histogram.begin(), histogram.end(), 0);
+    histogram_total = 0;
+    db.resize(num_bins);
+    scratch.resize(num_bins);
+}
+
+unsigned long bSpectrumAverager::getNumUpdates()
+{
+    return num_updates;
+}
+
+void bSpectrumAverager::setOutput(vector<Spectrum> &_out, const float *_power)
+{
+    bFastMath_Log10(_power, &db[0], num_bins, 10.0f);
+    for( int i = 0; i < num_bins; i++ ){
+        _out[i].power = _power[i];
+        _out[i].db = db[i];
+    }
+}
+
+void bSpectrumAverager::update(const float *_power)
+{
+    if( num_bins == 0 ){
+        return;
+    }
+    num_updates++;
+
+    // Welch: running sum over a ring of the last segments
+    float *oldest = &segment_ring[(size_t)segment_pos*num_bins];
+    for( int i = 0; i < num_bins; i++ ){
+        welch_sum[i] += (double)_power[i] - oldest[i];
+        oldest[i] = _power[i];
+    }
+    segment_pos = (segment_pos+1) % segments;
+    if( segment_count < segments ) segment_count++;
+    float inv = 1.0f/segment_count;
+    for( int i = 0; i < num_bins; i++ ){
+        welch_mean[i] = welch_sum[i]*inv;
+    }
+    setOutput(welch, &welch_mean[0]);
+
+    // exponential smoothing, starting from the first frame
+    float a = num_updates == 1 ? 0 : smoothing_alpha;
+    for( int i = 0; i < num_bins; i++ ){
+        smoothed_power[i] = a*smoothed_power[i] + (1-a)*_power[i];
+    }
+    setOutput(smoothed, &smoothed_power[0]);
+
+    // peak hold
+    for( int i = 0; i < num_bins; i++ ){
+        float p = peak_power[i]*peak_decay;
+        peak_power[i] = p > _power[i] ? p : _power[i];
+    }
+    setOutput(peak, &peak_power[0]);
+
+    // percentile histograms: bucket index of every bin, then count
+    bFastMath_Log10(_power, &scratch[0], num_bins, 10.0f);
+    float inv_step = 1.0f/db_step;
+    for( int i = 0; i < num_bins; i++ ){
+        float b = (scratch[i]-db_min)*inv_step;
+        b = b < 0 ? 0 : b;
+        b = b > num_buckets-1 ? num_buckets-1 : b;
+        scratch[i] = b;
+    }
+    uint32_t *h = &histogram[0];
+    for( int i = 0; i < num_bins; i++ ){
+        h[(size_t)i*num_buckets + (int)scratch[i]]++;
+    }
+    // keep counters bounded: halve everything, proportions stay
+    if( ++histogram_total == 0x80000000u ){
+        for( size_t i = 0; i < histogram.size(); i++ ){
+            histogram[i] >>= 1;
+        }
+        histogram_total >>= 1;
+    }
+}
+
+const vector<Spectrum> &bSpectrumAverager::getPercentile(float _q)
+{
+    if( histogram_total == 0 ){
+        return percentile;
+    }
+    percentileOf(&histogram[0], num_bins, num_buckets, db_min, db_step, _q, percentile);
+    return percentile;
+}
+
+void bSpectrumAverager::copyHistogram(bSpectrumHistogram &_histogram)
+{
+    _histogram.num_bins = num_bins;
+    _histogram.num_buckets = num_buckets;
+    _histogram.freq_step = freq_step;
+    _histogram.db_min = db_min;
+    _histogram.db_step = db_step;
+    _histogram.total = histogram_total;
+    _histogram.counts.assign(histogram.begin(), histogram.end());
+}
+
+void bSpectrumAverager::getPercentile(const bSpectrumHistogram &_histogram, float _q, vector<Spectrum> &_out)
+{
+    _out.resize(_histogram.num_bins);
+    for( int i = 0; i < _histogram.num_bins; i++ ){
+        _out[i].Hz = _histogram.freq_step*i;
+        _out[i].power = 0;
+        _out[i].db = 0;
+    }
+    if( _histogram.total == 0 ){
+        return;
+    }
+    percentileOf(&_histogram.counts[0], _histogram.num_bins, _histogram.num_buckets,
+                 _histogram.db_min, _histogram.db_step, _q, _out);
+}
+
+void bSpectrumAverager::percentileOf(const uint32_t *_histogram, int _num_bins, int _num_buckets,
+                                     float _db_min, float _db_step, float _q, vector<Spectrum> &_out)
+{
+    _q = ofClamp(_q, 0.0f, 1.0f);
+    for( int i = 0; i < _num_bins; i++ ){
+        const uint32_t *h = &_histogram[(size_t)i*_num_buckets];
+        // counts after halving may sum a little below histogram_total
+        uint64_t total = 0;
+        for( int k = 0; k < _num_buckets; k++ ){
+            total += h[k];
+        }
+        double target = _q*total;
+        uint64_t cumulative = 0;
+        int k = 0;
+        for( ; k < _num_buckets-1; k++ ){
+            if( cumulative + h[k] >= target ){
+                break;
+            }
+            cumulative += h[k];
+        }
+        // linear within the bucket
+        double frac = h[k] > 0 ? (target-cumulative)/h[k] : 0.5;
+        float d = _db_min + (k + (float)frac)*_db_step;
+        _out[i].db = d;
+        _out[i].power = pow(10.0f, d/10.0f);
+    }
+}
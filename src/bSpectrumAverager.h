@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ofMain.h"
+#include "bFFT.h"
+
+// Copy of the percentile histograms, to compute a percentile from outside
+// the thread (or lock) that feeds the averager.
+struct bSpectrumHistogram{
+    int num_bins, num_buckets;
+    float freq_step, db_min, db_step;
+    uint32_t total;
+    vector<uint32_t> counts;    // num_bins x num_buckets
+};
+
+// Long-term views of a power spectrum, fed with bFFT::power after each update.
+//
+//  welch      mean of the last N periodograms (Welch's method when the
+//             segments overlap). bFFT power units; times getPsdScale() of
+//             the bFFT gives a one-sided PSD.
+//  smoothed   exponential average with a time constant
+//  peak       running maximum, optionally decaying
+//  percentile level not exceeded q of the time (q = 0.1 is L90), from a
+//             per-bin histogram of dB values
+//
+// Memory is fixed at setup: N*bins for Welch and bins*buckets counters for
+// the percentiles, however long it runs. Per-update work is a few flat
+// loops over the bins.
+class bSpectrumAverager{
+public:
+    bSpectrumAverager();
+
+    // _update_seconds is the time between two update() calls
+    // settings made before setup are kept
+    void setup(int _num_bins, float _freq_step, float _update_seconds);
+    void setWelchSegments(int _segments);
+    void setSmoothing(float _time_constant_seconds);
+    // 0 holds peaks forever
+    void setPeakDecay(float _db_per_second);
+    // histogram of [_db_min, _db_max) in _db_step buckets, clears it
+    void setPercentileRange(float _db_min, float _db_max, float _db_step);
+    void reset();
+
+    void update(const float *_power);
+    // fills percentile for fraction _q (0..1) and returns it. scans every
+    // bucket of every bin, see copyHistogram to do that elsewhere.
+    const vector<Spectrum> &getPercentile(float _q);
+    // a flat copy, reuses _histogram's memory
+    void copyHistogram(bSpectrumHistogram &_histogram);
+    // percentile _q of a copied histogram into _out, sized to its bins
+    static void getPercentile(const bSpectrumHistogram &_histogram, float _q, vector<Spectrum> &_out);
+    unsigned long getNumUpdates();
+
+    vector<Spectrum> welch;
+    vector<Spectrum> smoothed;
+    vector<Spectrum> peak;
+    vector<Spectrum> percentile;
+
+private:
+    void setOutput(vector<Spectrum> &_out, const float *_power);
+    static void percentileOf(const uint32_t *_histogram, int _num_bins, int _num_buckets,
+                             float _db_min, float _db_step, float _q, vector<Spectrum> &_out);
+
+    int num_bins;
+    float freq_step, update_seconds;
+    unsigned long num_updates;
+
+    int segments, segment_pos, segment_count;
+    vector<float> segment_ring;     // segments x num_bins
+    vector<double> welch_sum;
+    vector<float> welch_mean;
+
+    // seconds and dB/s as set, the per-update factors depend on update_seconds
+    float smoothing_seconds, peak_decay_db;
+    float smoothing_alpha;
+    vector<float> smoothed_power;
+
+    float peak_decay;
+    vector<float> peak_power;
+
+    float db_min, db_step;
+    int num_buckets;
+    vector<uint32_t> histogram;     // num_bins x num_buckets
+    uint32_t histogram_total;
+    vector<float> db, scratch;
+};
@@ -0,0 +1,185 @@
+#include "bZoomFFT.h"
+
+bZoomFFT::bZoomFFT()
+{
+    fmin = fmax = center = 0;
+    sampling_rate = fft_size = 0;
+    decimation = 1;
+    taps = 0;
+    max_power = 0;
+}
+
+bool bZoomFFT::setup(float _fmin, float _fmax, int _fft_size, int _sampling_rate, int _taps_per_phase)
+{
+    if( _fmin < 0 || _fmax <= _fmin || _fmax > _sampling_rate/2.0f ){
+        ofLogError("bZoomFFT") << "invalid band " << _fmin << " - " << _fmax << " Hz";
+        return false;
+    }
+    plan = bFFT_GetPlan(2*_fft_size);
+    if( !plan ){
+        return false;
+    }
+
+    fmin = _fmin;
+    fmax = _fmax;
+    center = (fmin+fmax)/2.0f;
+    sampling_rate = _sampling_rate;
+    fft_size = _fft_size;
+
+    // the cutoff sits at the decimated Nyquist fs/(2D) and the Blackman
+    // transition is about 5.5*fs/(D*taps_per_phase) wide. the passband must
+    // reach bandwidth/2 and the stopband must start by fs/D - bandwidth/2,
+    // the lowest frequency that aliases into the band, so
+    // fs/D >= bandwidth + transition.
+    float bandwidth = fmax-fmin;
+    int taps_per_phase = max(8, _taps_per_phase);
+    decimation = max(1, (int)(sampling_rate*(1.0f - 5.5f/taps_per_phase)/bandwidth));
+    taps = decimation*taps_per_phase;
+
+    // windowed sinc (Blackman) low-pass at the decimated Nyquist, unity DC gain
+    float cutoff = 0.5f/decimation;
+    vector<double> h(taps);
+    double sum = 0;
+    for( int i = 0; i < taps; i++ ){
+        double m = i - (taps-1)/2.0;
+        double sinc = m == 0 ? 2*cutoff : sin(2*M_PI*cutoff*m)/(M_PI*m);
+        double w = 0.42 - 0.5*cos(2*M_PI*i/(taps-1)) + 0.08*cos(4*M_PI*i/(taps-1));
+        h[i] = sinc*(taps > 1 ? w : 1.0);
+        sum += h[i];
+    }
+    coeffs.resize(taps);
+    for( int i = 0; i < taps; i++ ){
+        coeffs[i] = h[taps-1-i]/sum;
+    }
+
+    step_real = cos(-2*M_PI*center/sampling_rate);
+    step_imag = sin(-2*M_PI*center/sampling_rate);
+    hist_real.resize(2*taps);
+    hist_imag.resize(2*taps);
+    dec_real.resize(2*fft_size);
+    dec_imag.resize(2*fft_size);
+
+    window.resize(fft_size);
+    for( int i = 0; i < fft_size; i++ ){
+        window[i] = 0.50 - 0.50*cos(2*M_PI*i/(fft_size-1));
+    }
+    in_real.resize(fft_size);
+    in_imag.resize(fft_size);
+    out_real.resize(fft_size);
+    out_imag.resize(fft_size);
+
+    // bins from -fft_size/2 to fft_size/2-1 around the centre, inside the band
+    bins.clear();
+    spectrum.clear();
+    float step = getFreqStep();
+    for( int k = -fft_size/2; k < fft_size/2; k++ ){
+        float hz = center + k*step;
+        if( hz < fmin || hz > fmax ){
+            continue;
+        }
+        Spectrum s;
+        s.power = 0;
+        s.db = 0;
+        s.Hz = hz;
+        spectrum.push_back(s);
+        bins.push_back((k+fft_size) % fft_size);
+    }
+    reset();
+    return true;
+}
+
+void bZoomFFT::reset()
+{
+    osc_real = 1;
+    osc_imag = 0;
+    fill(hist_real.begin(), hist_real.end(), 0);
+    fill(hist_imag.begin(), hist_imag.end(), 0);
+    hist_pos = 0;
+    phase = 0;
+    fill(dec_real.begin(), dec_real.end(), 0);
+    fill(dec_imag.begin(), dec_imag.end(), 0);
+    dec_pos = 0;
+    for( int i = 0; i < spectrum.size(); i++ ){
+        spectrum[i].power = 0;
+        spectrum[i].db = 0;
+    }
+    max_power = 0;
+}
+
+void bZoomFFT::update(const float *_input, int _num_samples)
+{
+    if( !plan ){
+        return;
+    }
+
+    for( int n = 0; n < _num_samples; n++ ){
+        float x = _input[n];
+        hist_real[hist_pos] = hist_real[hist_pos+taps] = x*osc_real;
+        hist_imag[hist_pos] = hist_imag[hist_pos+taps] = x*osc_imag;
+        if( ++hist_pos == taps ) hist_pos = 0;
+
+        double r = osc_real*step_real - osc_imag*step_imag;
+        osc_imag = osc_real*step_imag + osc_imag*step_real;
+        osc_real = r;
+
+        // polyphase decimation: the filter only runs for the kept samples
+        if( ++phase < decimation ){
+            continue;
+        }
+        phase = 0;
+        const float *hr = &hist_real[hist_pos];
+        const float *hi = &hist_imag[hist_pos];
+        float yr = 0, yi = 0;
+        for( int k = 0; k < taps; k++ ){
+            yr += coeffs[k]*hr[k];
+            yi += coeffs[k]*hi[k];
+        }
+        dec_real[dec_pos] = dec_real[dec_pos+fft_size] = yr;
+        dec_imag[dec_pos] = dec_imag[dec_pos+fft_size] = yi;
+        if( ++dec_pos == fft_size ) dec_pos = 0;
+    }
+
+    // keep the phasor on the unit circle
+    double mag = sqrt(osc_real*osc_real + osc_imag*osc_imag);
+    osc_real /= mag;
+    osc_imag /= mag;
+
+    // oldest first; conjugated because bFFT_PlannedFFT uses the exp(+i) kernel
+    for( int i = 0; i < fft_size; i++ ){
+        in_real[i] = dec_real[dec_pos+i]*window[i];
+        in_imag[i] = -dec_imag[dec_pos+i]*window[i];
+    }
+    bFFT_PlannedFFT(*plan, &in_real[0], &in_imag[0], &out_real[0], &out_imag[0]);
+
+    max_power = 0;
+    for( int i = 0; i < spectrum.size(); i++ ){
+        int k = bins[i];
+        float p = out_real[k]*out_real[k] + out_imag[k]*out_imag[k];
+        spectrum[i].power = p;
+        spectrum[i].db = 10*log10(p);
+        if( max_power < p ) max_power = p;
+    }
+}
+
+float bZoomFFT::getCenterFrequency()
+{
+    return center;
+}
+
+int bZoomFFT::getDecimation()
+{
+    return decimation;
+}
+
+int bZoomFFT::getNumBins()
+{
+    return spectrum.size();
+}
+
+float bZoomFFT::getFreqStep()
+{
+    if( fft_size == 0 ){
+        return 0;
+    }
+    return sampling_rate/(float)(decimation*fft_size);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ofMain.h"
+#include "bFFT.h"
+
+// Band limited (zoom) spectrum.
+//
+// The input is mixed down so the centre of [fmin, fmax] sits at 0 Hz,
+// low-pass filtered and decimated by a polyphase FIR (only every D-th
+// output is computed), and a complex FFT runs over the last fft_size
+// decimated samples. Resolution is sampling_rate/(D*fft_size), so a narrow
+// band gets fine bins from a small FFT. spectrum holds the bins inside
+// [fmin, fmax] in ascending order with absolute Hz.
+class bZoomFFT {
+public:
+    bZoomFFT();
+
+    // _fft_size must be a power of two. _taps_per_phase sets the filter
+    // length (D*_taps_per_phase taps, at least 8); more taps give a sharper
+    // band edge and so allow a larger decimation.
+    bool setup(float _fmin, float _fmax, int _fft_size, int _sampling_rate, int _taps_per_phase = 16);
+    // clears the mixer phase and the filter and FFT history, as after setup
+    void reset();
+    // feeds _num_samples samples and recomputes the spectrum
+    void update(const float *_input, int _num_samples);
+
+    float getCenterFrequency();
+    int getDecimation();
+    float getFreqStep();
+    // bins inside [fmin, fmax], the size of spectrum
+    int getNumBins();
+
+    vector<Spectrum> spectrum;
+    float max_power;
+
+private:
+    float fmin, fmax, center;
+    int sampling_rate, fft_size, decimation, taps;
+    shared_ptr<const bFFTPlan> plan;
+
+    // mixer: exp(-i*2*pi*center*n/sampling_rate) as a rotating phasor
+    double osc_real, osc_imag, step_real, step_imag;
+    // low-pass taps, reversed so the dot product walks the history forwards
+    vector<float> coeffs;
+    // mixed samples, written twice (pos and pos+taps) so the last taps are contiguous
+    vector<float> hist_real, hist_imag;
+    int hist_pos, phase;
+    // decimated samples, same trick
+    vector<float> dec_real, dec_imag;
+    int dec_pos;
+
+    vector<float> window, in_real, in_imag, out_real, out_imag;
+    vector<int> bins;     // FFT bin of each spectrum entry
+};
@@ -2,17 +2,209 @@
 
 ofxbSoundUtils::ofxbSoundUtils()
 {
-    
+    bufsize = 0;
+    count_should_be_updated = 0;
+    source = NULL;
+    sound = NULL;
+    pool = NULL;
+    pool_stream = NULL;
+    stream_pool = NULL;
+    recorder = NULL;
+    pool_queue_length = 8;
+    use_zoom = false;
+    use_multires = false;
+    averaging = false;
+    peak_tracking = false;
+    spectrum_source = OFXBSU_SPECTRUM_SOURCE_INSTANT;
+    spectrum_percentile = 0.1f;
+    has_previous_frame = false;
+    input_position = 0;
+    analyzed_position = 0;
 }
 
 ofxbSoundUtils::~ofxbSoundUtils()
 {
-    
+    if( source ){
+        source->stop();
+    }
+    if( pool_stream ){
+        stream_pool->removeStream(pool_stream);
+    }
+}
+
+void ofxbSoundUtils::setAnalyzerPool(bAnalyzerPool *_pool, int _queue_length)
+{
+    pool = _pool;
+    pool_queue_length = _queue_length;
+}
+
+void ofxbSoundUtils::setRecorder(bSoundRecorder *_recorder)
+{
+    recorder = _recorder;
 }
 
 void ofxbSoundUtils::setLoudnessType(int _type)
 {
     loudness_type = _type;
+    // drawing needs power, plus dB for the dB views
+    if( loudness_type == OFXBSU_LOUDNESS_TYPE_DB ){
+        fft.setOutputMask(fft.output_mask | BFFT_OUTPUT_DB);
+    }
+}
+
+bool ofxbSoundUtils::setZoomBand(float _fmin, float _fmax, int _fft_size)
+{
+    if( _fft_size == 0 ){
+        _fft_size = bufsize/2;
+    }
+    lock_guard<mutex> lock(analysis_mutex);
+    use_zoom = zoom.setup(_fmin, _fmax, _fft_size, fft.sampling_rate);
+    return use_zoom;
+}
+
+void ofxbSoundUtils::clearZoomBand()
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    use_zoom = false;
+}
+
+void ofxbSoundUtils::addResolutionBand(float _fmin, float _fmax, int _fft_size)
+{
+    // update() waits for the bands, the audio thread must not
+    if( pool_stream == NULL && bufsize > 0 ){
+        own_pool.setup(1);
+        addPoolStream(&own_pool);
+    }
+    lock_guard<mutex> lock(analysis_mutex);
+    if( multires.getNumBands() == 0 ){
+        multires.setup(fft.sampling_rate, bufsize);
+        multires.setPool(pool);
+    }
+    multires.addBand(_fmin, _fmax, _fft_size);
+    use_multires = multires.getNumBands() > 0;
+}
+
+void ofxbSoundUtils::clearResolutionBands()
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    multires.clearBands();
+    use_multires = false;
+}
+
+void ofxbSoundUtils::setAveraging(bool _enable)
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    averaging = _enable;
+    // before setup the buffers are sized by setup()
+    if( averaging && bufsize > 0 ){
+        setupAveraging();
+    }
+    has_previous_frame = false;
+}
+
+void ofxbSoundUtils::setupAveraging()
+{
+    if( overlap_fft.bufsize == bufsize ){
+        return;
+    }
+    overlap_fft.setup(bufsize, fft.sampling_rate);
+    overlap_fft.setOutputMask(BFFT_OUTPUT_POWER);
+    overlap_frame.resize(bufsize);
+    previous_frame.resize(bufsize);
+    // one update per half frame with the overlapped segments
+    averager.setup(bufsize/2, fft.getFreqStep(), bufsize/2.0f/fft.sampling_rate);
+}
+
+void ofxbSoundUtils::setWelchSegments(int _segments)
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    averager.setWelchSegments(_segments);
+}
+
+void ofxbSoundUtils::setSmoothing(float _time_constant_seconds)
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    averager.setSmoothing(_time_constant_seconds);
+}
+
+void ofxbSoundUtils::setPeakDecay(float _db_per_second)
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    averager.setPeakDecay(_db_per_second);
+}
+
+void ofxbSoundUtils::setPercentileRange(float _db_min, float _db_max, float _db_step)
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    averager.setPercentileRange(_db_min, _db_max, _db_step);
+}
+
+void ofxbSoundUtils::setSpectrumSource(int _source, float _percentile)
+{
+    if( _source != OFXBSU_SPECTRUM_SOURCE_INSTANT && !averaging ){
+        setAveraging(true);
+    }
+    lock_guard<mutex> lock(analysis_mutex);
+    spectrum_source = _source;
+    spectrum_percentile = _percentile;
+}
+
+void ofxbSoundUtils::setPeakTracking(bool _enable, int _max_peaks, float _min_db)
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    if( _enable ){
+        peak_tracker.setup(_max_peaks, _min_db);
+        // phase refines the peaks of the full band transform
+        fft.setOutputMask(fft.output_mask | BFFT_OUTPUT_PHASE);
+    }
+    peak_tracking = _enable;
+}
+
+vector<bPeak> ofxbSoundUtils::getPeaks()
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    return peak_tracker.peaks;
+}
+
+vector<bPartial> ofxbSoundUtils::getPartials()
+{
+    lock_guard<mutex> lock(analysis_mutex);
+    return peak_tracker.partials;
+}
+
+vector<Spectrum> ofxbSoundUtils::getSpectrum()
+{
+    vector<Spectrum> s;
+    bSpectrumHistogram h;
+    copySpectrum(s, h);
+    return s;
+}
+
+void ofxbSoundUtils::copySpectrum(vector<Spectrum> &_out, bSpectrumHistogram &_histogram)
+{
+    float q;
+    {
+        lock_guard<mutex> lock(analysis_mutex);
+        if( use_zoom ){
+            _out = zoom.spectrum;
+            return;
+        }
+        if( use_multires ){
+            _out = multires.spectrum;
+            return;
+        }
+        switch( spectrum_source ){
+            case OFXBSU_SPECTRUM_SOURCE_WELCH: _out = averager.welch; return;
+            case OFXBSU_SPECTRUM_SOURCE_SMOOTHED: _out = averager.smoothed; return;
+            case OFXBSU_SPECTRUM_SOURCE_PEAK: _out = averager.peak; return;
+            case OFXBSU_SPECTRUM_SOURCE_PERCENTILE: break;
+            default: _out = fft.spectrum; return;
+        }
+        // the bins x buckets scan would hold up analyze(), copy the counts
+        averager.copyHistogram(_histogram);
+        q = spectrum_percentile;
+    }
+    bSpectrumAverager::getPercentile(_histogram, q, _out);
 }
 
 void ofxbSoundUtils::drawSpectrum(int _x, int _y, int _w, int _h)
@@ -30,6 +222,27 @@ void ofxbSoundUtils::drawSettings(int _x, int _y)
     ofDrawBitmapString(string_device_info, _x, _y);
 }
 
+bSoundStatsSnapshot ofxbSoundUtils::getStats()
+{
+    bSoundStatsSnapshot s = stats.getSnapshot();
+    bAnalyzerPool::Stream *stream = pool_stream;
+    if( stream ){
+        s.queue_depth = stream->getQueueDepth();
+        s.queue_length = stream->getQueueLength();
+        s.frames_dropped = stream->getFramesDropped();
+    }
+    bSoundRecorder *r = recorder;
+    if( r ){
+        s.recorder_dropped = r->getBlocksDropped();
+    }
+    return s;
+}
+
+void ofxbSoundUtils::drawStats(int _x, int _y)
+{
+    stats.draw(getStats(), _x, _y);
+}
+
 ofPixels ofxbSoundUtils::getPixelsFromSpectrogram()
 {
     ofPixels p;
@@ -46,22 +259,31 @@ void ofxbSoundUtils::drawSpectrogram(int _x, int _y, int _w, int _h)
 
 void ofxbSoundUtils::updateFbo()
 {
+    // copy the latest spectrum so the analysis thread can keep going
+    copySpectrum(spectrum_frame, spectrum_histogram);
+    int framesize = bufsize/2;
+    int n = spectrum_frame.size();
+    if( n == 0 ){
+        return;
+    }
+    
     fbo_spectrum_power.begin();
     {
         ofClear(0);
         ofNoFill();
         ofSetColor(255);
         ofBeginShape();
-        for( int i = 0; i < fft.spectrum.size(); i++ ){
-            float y = bufsize/2-fft.spectrum[i].power;
-            if( y >= fft.spectrum.size() ){
-                ofVertex(i, fft.spectrum.size()-1);
+        for( int i = 0; i < n; i++ ){
+            float x = i*framesize/(float)n;
+            float y = framesize-spectrum_frame[i].power;
+            if( y >= framesize ){
+                ofVertex(x, framesize-1);
             }
             else if( y < 0 ){
-                ofVertex(i, 0);
+                ofVertex(x, 0);
             }
             else{
-                ofVertex(i, bufsize/2-fft.spectrum[i].power);
+                ofVertex(x, y);
             }
         }
         ofEndShape();
@@ -74,25 +296,26 @@ void ofxbSoundUtils::updateFbo()
         ofNoFill();
         ofSetColor(255);
         ofBeginShape();
-        for( int i = 0; i < fft.spectrum.size(); i++ ){
-            ofVertex(i, 40-fft.spectrum[i].db);
+        for( int i = 0; i < n; i++ ){
+            ofVertex(i*framesize/(float)n, 40-spectrum_frame[i].db);
         }
         ofEndShape();
     }
     fbo_spectrum_db.end();
     
-    int framesize = bufsize/2;
     for( int i = framesize-1; i >= 1; i-- ){
-        for( int j = 0; j < bufsize/2; j++ ){
+        for( int j = 0; j < framesize; j++ ){
             buf_spectrogram[j][i] = buf_spectrogram[j][i-1];
         }
     }
+    // row j (top is the highest frequency) takes the spectrum entry under it
     for( int j = 0; j < framesize; j++ ){
+        const Spectrum &s = spectrum_frame[(framesize-1-j)*n/framesize];
         if( loudness_type == OFXBSU_LOUDNESS_TYPE_POWER){
-            buf_spectrogram[j][0] = fft.spectrum[framesize-1-j].power;
+            buf_spectrogram[j][0] = s.power;
         }
         else if( loudness_type == OFXBSU_LOUDNESS_TYPE_DB){
-            buf_spectrogram[j][0] = fft.spectrum[framesize-1-j].db;
+            buf_spectrogram[j][0] = s.db;
         }
     }
     
@@ -118,64 +341,105 @@ void ofxbSoundUtils::update()
     if( count_should_be_updated <= 0 ){
         return;
     }
+    uint64_t t = ofGetElapsedTimeMicros();
     updateFbo();
+    stats.update_fbo.add(ofGetElapsedTimeMicros()-t);
     count_should_be_updated--;
    
 }
 
 
-void ofxbSoundUtils::setup(int _bufsize, int _sampling_rate, bool _use_output)
+void ofxbSoundUtils::setup(int _bufsize, bSoundSource *_source, bool _start)
 {
-    auto devices = soundStream.getDeviceList();
-    for( int i = 0; i < devices.size(); i++ ){
-        if( devices[i].isDefaultInput ){
-            string_device_info += "Input Device: "+devices[i].name + "\n";
-            settings.setInDevice(devices[i]);
-            string_device_info += " - Configurable Sampling Rate: ";
-            for( int j = 0; j < devices[i].sampleRates.size(); j++){
-                string_device_info += ofToString(devices[i].sampleRates[j])+",";
-            }
-            if( _sampling_rate == 0 ){
-                settings.sampleRate = devices[i].sampleRates[0];
-            }
-            else{
-                settings.sampleRate = _sampling_rate;
-            }
-            settings.numInputChannels = devices[i].inputChannels;
-            
-        }
-        if( devices[i].isDefaultOutput && _use_output ){
-            settings.setOutDevice(devices[i]);
-            settings.numOutputChannels = devices[i].outputChannels;
-            string_device_info += "\nOutput Device: "+devices[i].name+"\n";
-            string_device_info += " - Configurable Sampling Rate: ";
-            for( int j = 0; j < devices[i].sampleRates.size(); j++){
-                string_device_info += ofToString(devices[i].sampleRates[j])+",";
-            }
-        }
-        
-    }
+    source = _source;
+    int sampling_rate = source->getSampleRate();
+    string_device_info = source->getDescription();
     string_device_info += "\n";
-    string_device_info += "Sampling Rate: " + ofToString(settings.sampleRate);
+    string_device_info += "Sampling Rate: " + ofToString(sampling_rate);
     string_device_info += ", Buffer Size: " + ofToString(_bufsize);
-    string_device_info += ", Callback Freq: " + ofToString(settings.sampleRate/_bufsize);
+    string_device_info += ", Callback Freq: " + ofToString(sampling_rate/_bufsize);
     
-    settings.bufferSize = bufsize = _bufsize;
+    bufsize = _bufsize;
     
     buf_spectrogram = new float*[_bufsize/2];
     for( int i = 0; i < _bufsize/2; i++){
         buf_spectrogram[i] = new float[_bufsize];
     }
-    fft.setup(settings.bufferSize, settings.sampleRate);
+    fft.setup(bufsize, sampling_rate);
+    // keeps BFFT_OUTPUT_ALL or a mask set before setup, drawing needs power
+    fft.setOutputMask(fft.output_mask | BFFT_OUTPUT_POWER);
     fbo_spectrum_power.allocate(_bufsize/2, _bufsize/2);
     fbo_spectrum_db.allocate(_bufsize/2, _bufsize/2);
     fbo_spectrogram.allocate(_bufsize/2, _bufsize/2);
-    sound = new float[_bufsize];
+    ingest.setup(bufsize, source->getNumChannels());
+    sound = ingest.getChannel(0);
     loudness_type = OFXBSU_LOUDNESS_TYPE_POWER;
-    
-    settings.setInListener(this);
-    soundStream.setup(settings);
     count_should_be_updated = 0;
+    stats.setup(bufsize, sampling_rate);
+    if( averaging ){
+        // setAveraging or setSpectrumSource before setup
+        setupAveraging();
+    }
+    
+    if( pool ){
+        addPoolStream(pool);
+    }
+    
+    if( _start ){
+        start();
+    }
+}
+
+void ofxbSoundUtils::addPoolStream(bAnalyzerPool *_pool)
+{
+    stream_pool = _pool;
+    pool_stream = _pool->addStream(bufsize, pool_queue_length, [this](float *_frame, uint64_t _position){
+        analyze(_frame, _position);
+    });
+}
+
+bool ofxbSoundUtils::start()
+{
+    if( source == NULL ){
+        return false;
+    }
+    return source->start(bufsize, [this](const void *_samples, int _format, int _num_frames, int _num_channels){
+        audioIn(_samples, _format, _num_frames, _num_channels);
+    });
+}
+
+int ofxbSoundUtils::run()
+{
+    bSoundSourceOffline *offline = dynamic_cast<bSoundSourceOffline *>(source);
+    if( offline == NULL ){
+        ofLogError("ofxbSoundUtils") << "run() needs an offline source (file or synth)";
+        return 0;
+    }
+    // a rerun gives the same result: start the analysis over with the source
+    {
+        lock_guard<mutex> lock(analysis_mutex);
+        peak_tracker.reset();
+        averager.reset();
+        zoom.reset();
+        multires.reset();
+        has_previous_frame = false;
+        analyzed_position = 0;
+    }
+    int blocks = offline->run(bufsize, [this](const void *_samples, int _format, int _num_frames, int _num_channels){
+        audioIn(_samples, _format, _num_frames, _num_channels);
+    });
+    // results are complete when this returns
+    bAnalyzerPool::Stream *stream = pool_stream;
+    if( stream ){
+        stream->flush();
+    }
+    return blocks;
+}
+
+void ofxbSoundUtils::setup(int _bufsize, int _sampling_rate, bool _use_output)
+{
+    device.setup(_sampling_rate, _use_output);
+    setup(_bufsize, &device);
 }
 
 void ofxbSoundUtils::setup(int _bufsize, int _sampling_rate)
@@ -191,16 +455,89 @@ void ofxbSoundUtils::setup(int _bufsize)
     setup(_bufsize, false);
 }
 
-void ofxbSoundUtils::audioIn(ofSoundBuffer &input)
+void ofxbSoundUtils::analyze(float *_frame, uint64_t _position)
 {
-    for (int i = 0; i < input.getBuffer().size(); i++){
-        sound[i] = input.getSample(i,0);
+    lock_guard<mutex> lock(analysis_mutex);
+    uint64_t t = ofGetElapsedTimeMicros();
+    // samples since the last analyzed frame, more than bufsize after a
+    // dropped frame. 0 when either frame was not one contiguous block.
+    int hop = 0;
+    if( _position > 0 && analyzed_position > 0 ){
+        // capped, past one frame it only tells that frames were dropped
+        hop = (int)min(_position - analyzed_position, (uint64_t)2*bufsize);
+    }
+    analyzed_position = _position;
+    // zoom and multi-resolution replace the full band transform unless averaging needs it
+    if( use_zoom ){
+        zoom.update(_frame, bufsize);
+    }
+    if( use_multires ){
+        multires.update(_frame, bufsize);
+    }
+    if( (!use_zoom && !use_multires) || averaging ){
+        fft.update(_frame);
     }
+    stats.fft.add(ofGetElapsedTimeMicros()-t);
     
-    fft.update(sound);    
+    if( averaging ){
+        t = ofGetElapsedTimeMicros();
+        int half = bufsize/2;
+        if( has_previous_frame ){
+            memcpy(&overlap_frame[0], &previous_frame[half], half*sizeof(float));
+            memcpy(&overlap_frame[half], _frame, half*sizeof(float));
+            overlap_fft.update(&overlap_frame[0]);
+            averager.update(overlap_fft.power);
+        }
+        averager.update(fft.power);
+        memcpy(&previous_frame[0], _frame, bufsize*sizeof(float));
+        has_previous_frame = true;
+        stats.feature.add(ofGetElapsedTimeMicros()-t);
+    }
+    if( peak_tracking ){
+        t = ofGetElapsedTimeMicros();
+        if( use_zoom ) peak_tracker.update(zoom.spectrum);
+        else if( use_multires ) peak_tracker.update(multires.spectrum);
+        else peak_tracker.update(fft, hop);
+        stats.feature.add(ofGetElapsedTimeMicros()-t);
+    }
     count_should_be_updated++;
 }
 
+void ofxbSoundUtils::audioIn(ofSoundBuffer &input)
+{
+    audioIn(&input.getBuffer()[0], OFXBSU_SAMPLE_FORMAT_FLOAT32, input.getNumFrames(), input.getNumChannels());
+}
+
+void ofxbSoundUtils::audioIn(const float *_samples, int _num_frames, int _num_channels)
+{
+    audioIn(_samples, OFXBSU_SAMPLE_FORMAT_FLOAT32, _num_frames, _num_channels);
+}
+
+void ofxbSoundUtils::audioIn(const void *_samples, int _format, int _num_frames, int _num_channels)
+{
+    uint64_t t = ofGetElapsedTimeMicros();
+    // raw block as received, copied into the recorder's ring
+    bSoundRecorder *r = recorder;
+    if( r ){
+        r->push(_samples, _format, _num_frames, _num_channels);
+    }
+    // at most bufsize frames, a short block keeps the tail of the previous one
+    int frames = ingest.ingest(_samples, _format, _num_frames, _num_channels);
+    input_position += frames;
+    // such a frame is not a window of consecutive samples, it gets no position
+    uint64_t position = frames == bufsize ? input_position : 0;
+    
+    bAnalyzerPool::Stream *stream = pool_stream;
+    if( stream ){
+        // a file or synth can wait for the pool, a device can not
+        stream->push(sound, source && !source->isLive(), position);
+    }
+    else{
+        analyze(sound, position);
+    }
+    stats.addCallback(t, ofGetElapsedTimeMicros()-t);
+}
+
 
 void ofxbSoundUtils::audioOut(ofSoundBuffer &output)
 {
@@ -2,11 +2,26 @@
 
 #include "ofMain.h"
 #include "bFFT.h"
+#include "bAnalyzerPool.h"
+#include "bSoundStats.h"
+#include "bSoundSource.h"
+#include "bZoomFFT.h"
+#include "bSpectrumAverager.h"
+#include "bMultiResolutionFFT.h"
+#include "bSoundIngest.h"
+#include "bPeakTracker.h"
+#include "bSoundRecorder.h"
 
 
 #define OFXBSU_LOUDNESS_TYPE_POWER 1
 #define OFXBSU_LOUDNESS_TYPE_DB 2
 
+#define OFXBSU_SPECTRUM_SOURCE_INSTANT 0
+#define OFXBSU_SPECTRUM_SOURCE_WELCH 1
+#define OFXBSU_SPECTRUM_SOURCE_SMOOTHED 2
+#define OFXBSU_SPECTRUM_SOURCE_PEAK 3
+#define OFXBSU_SPECTRUM_SOURCE_PERCENTILE 4
+
 class ofxbSoundUtils{
 public:
     ofxbSoundUtils();
@@ -16,8 +31,55 @@ public:
     void setup(int _bufsize, bool _use_output);
     void setup(int _bufsize, int _sampling_rate);
     void setup(int _bufsize, int _sampling_rate, bool _use_output);
+    // analyze a file, synthetic or other source instead of the input device.
+    // with _start false nothing runs until run() (offline sources) or start().
+    void setup(int _bufsize, bSoundSource *_source, bool _start = true);
+    bool start();
+    // offline sources: rewinds and analyzes every block on the calling thread,
+    // waiting for the pool when there is one. returns the number of blocks.
+    int run();
     void setLoudnessType(int _type);
+    // run the FFT on a shared pool instead of the audio thread. call before setup.
+    void setAnalyzerPool(bAnalyzerPool *_pool, int _queue_length = 8);
+    // hand every input block to _recorder (set up with the source's rate,
+    // channels, format and bufsize), NULL to detach.
+    void setRecorder(bSoundRecorder *_recorder);
+    // analyze only [_fmin, _fmax] with a decimated (zoom) FFT, call after setup.
+    // _fft_size 0 uses bufsize/2. drawSpectrum/drawSpectrogram then show the band.
+    bool setZoomBand(float _fmin, float _fmax, int _fft_size = 0);
+    void clearZoomBand();
+    // multi-resolution spectrum: each band gets its own FFT size, e.g.
+    // (0, 500, 4096), (500, 4000, 1024), (4000, 22050, 256). call after setup.
+    // bands run in parallel on the analyzer pool (or a private one). they
+    // wait for each other, so without an analyzer pool the analysis moves
+    // from the audio thread to a private worker.
+    void addResolutionBand(float _fmin, float _fmax, int _fft_size);
+    void clearResolutionBands();
+    // feed averager with every frame plus the 50% overlapped frame between
+    // two frames (Welch). can be called before setup.
+    void setAveraging(bool _enable);
+    // averager settings, safe while the analysis runs (see bSpectrumAverager)
+    void setWelchSegments(int _segments);
+    void setSmoothing(float _time_constant_seconds);
+    void setPeakDecay(float _db_per_second);
+    void setPercentileRange(float _db_min, float _db_max, float _db_step);
+    // what drawSpectrum/drawSpectrogram show: OFXBSU_SPECTRUM_SOURCE_*.
+    // _percentile is the fraction for OFXBSU_SPECTRUM_SOURCE_PERCENTILE (0.1 is L90).
+    void setSpectrumSource(int _source, float _percentile = 0.1f);
+    // strongest _max_peaks peaks of every frame, linked into partials.
+    // runs on the zoom band, the multi-resolution bands or the full band FFT.
+    void setPeakTracking(bool _enable, int _max_peaks = 8, float _min_db = -100);
+    // copies of the latest frame's peaks and the live partials
+    vector<bPeak> getPeaks();
+    vector<bPartial> getPartials();
+    // spectrum currently drawn: the zoom band, the multi-resolution bands,
+    // or the full band from setSpectrumSource
+    // a copy, the analysis keeps rewriting its own buffers
+    vector<Spectrum> getSpectrum();
     void audioIn(ofSoundBuffer & input);
+    void audioIn(const float *_samples, int _num_frames, int _num_channels);
+    // interleaved block in any OFXBSU_SAMPLE_FORMAT_*, e.g. int16 from the network
+    void audioIn(const void *_samples, int _format, int _num_frames, int _num_channels);
     void audioOut(ofSoundBuffer & input);
     void update();
 
@@ -26,9 +88,12 @@ public:
     ofPixels getPixelsFromSpectrogram();
     void updateFbo();
     void drawSettings(int _x, int _y);
+    // runtime counters: callback/FFT/updateFbo timings, queue and xruns
+    bSoundStatsSnapshot getStats();
+    void drawStats(int _x, int _y);
     
-    ofSoundStream soundStream;
-    ofSoundStreamSettings settings;
+    bSoundSourceDevice device;
+    bSoundSource *source;
     float **buf_spectrogram;
 
     bFFT fft;
@@ -39,10 +104,56 @@ public:
     ofFbo fbo_spectrogram;
 
     int loudness_type;
+    // every input channel, deinterleaved to float
+    bSoundIngest ingest;
+    // channel 0 of ingest, what gets analyzed
     float *sound;
     string string_device_info;
-    int count_should_be_updated;
-    
+    atomic<int> count_should_be_updated;
 
-    
+    bAnalyzerPool *pool;
+    // on pool, or on the private worker started for multi-resolution bands
+    atomic<bAnalyzerPool::Stream *> pool_stream;
+    int pool_queue_length;
+    atomic<bSoundRecorder *> recorder;
+    bSoundStats stats;
+    bZoomFFT zoom;
+    bool use_zoom;
+    bMultiResolutionFFT multires;
+    bool use_multires;
+    bSpectrumAverager averager;
+    bool averaging;
+    bPeakTracker peak_tracker;
+    bool peak_tracking;
+    int spectrum_source;
+    float spectrum_percentile;
+
+private:
+    // FFT and features of one frame, on the audio thread or a pool worker.
+    // _position is the input frame count at the end of _frame.
+    void analyze(float *_frame, uint64_t _position);
+    // sizes the Welch overlap buffers and the averager for bufsize
+    void setupAveraging();
+    // queues the analysis on _pool instead of running it in audioIn
+    void addPoolStream(bAnalyzerPool *_pool);
+    // one worker for the analysis when bands need it and there is no pool
+    bAnalyzerPool own_pool;
+    // the pool pool_stream is on
+    bAnalyzerPool *stream_pool;
+
+    // held by analyze() and by settings that reshape the analysis
+    mutex analysis_mutex;
+    vector<Spectrum> spectrum_frame;
+    // fills _out with getSpectrum(). only a copy is made under the lock,
+    // percentiles are computed from _histogram after it is released.
+    void copySpectrum(vector<Spectrum> &_out, bSpectrumHistogram &_histogram);
+    // updateFbo's copy of the percentile counts
+    bSpectrumHistogram spectrum_histogram;
+    // Welch overlap: transform of the half/half frame between two frames
+    bFFT overlap_fft;
+    vector<float> overlap_frame, previous_frame;
+    bool has_previous_frame;
+    // input frames ingested so far (audio thread) and at the end of the
+    // last analyzed frame, 0 before the first (analysis)
+    uint64_t input_position, analyzed_position;
 };